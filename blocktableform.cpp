@@ -71,17 +71,34 @@ void BlockTableForm::setModbusClient(ModbusClient *client)
     }
 
     if (m_modbusClient) {
-        disconnect(m_modbusClient, &ModbusClient::readCompleted,
-                   this, &BlockTableForm::handleReadCompleted);
+        QMetaObject::invokeMethod(m_modbusClient,
+                                  [oldClient = m_modbusClient, form = static_cast<QObject *>(this)]() {
+                                      oldClient->unsubscribe(form);
+                                  },
+                                  Qt::QueuedConnection);
     }
-
     m_modbusClient = client;
-
-    if (m_modbusClient) {
-        connect(m_modbusClient, &ModbusClient::readCompleted,
-                this, &BlockTableForm::handleReadCompleted);
-        // requestAllValues();
+    if (!m_modbusClient) {
+        return;
     }
+
+    // Every read covering the form's registers is routed here, whoever requested it.
+    QMetaObject::invokeMethod(m_modbusClient,
+                              [client = m_modbusClient, form = QPointer<BlockTableForm>(this)]() {
+                                  if (!client || !form) {
+                                      return;
+                                  }
+                                  const auto onRead = [form](const ModbusResult &result) {
+                                      form->handleReadCompleted(result);
+                                  };
+                                  client->subscribe(BlockTableAddress::LaserControlBoardStatus,
+                                                    BlockTableAddress::AddressTillOfEndBlocks - BlockTableAddress::LaserControlBoardStatus,
+                                                    form,
+                                                    onRead,
+                                                    1,
+                                                    SubscriptionRouter::ChangesOnly);
+                              },
+                              Qt::QueuedConnection);
 }
 
 QList<int> BlockTableForm::getSplitterSizes()
@@ -94,8 +111,15 @@ void BlockTableForm::setSplitterSizes(const QList<int> &sizes)
     ui->splitter->setSizes(sizes);
 }
 
-void BlockTableForm::handleReadCompleted(int startAddress, const QVector<quint16> &values)
+void BlockTableForm::handleReadCompleted(const ModbusResult &result)
 {
+    if (!result.isOk()) {
+        return;
+    }
+
+    const int startAddress = result.startAddress;
+    const RegisterSlice &values = result.values;
+
     if (m_addressToRow.constFind(startAddress) != m_addressToRow.constEnd())
     {
         qDebug() << "Received" << values.size() << "registers starting from" << startAddress;
@@ -119,6 +143,7 @@ void BlockTableForm::handleReadCompleted(int startAddress, const QVector<quint16
 
             // Process the value(s) at current address
             std::variant<quint16, quint32> value;
+            const int firstIndex = valueIndex;
 
             if (relativeAddress == (BlockTableAddress::LaserControlBoardStatus - baseAddress) ||
                 relativeAddress == (BlockTableAddress::PowerSupplyControlStatus - baseAddress))
@@ -134,6 +159,10 @@ void BlockTableForm::handleReadCompleted(int startAddress, const QVector<quint16
             // Update the UI for this value
             const auto rowIt = m_addressToRow.constFind(currentAddress);
             if (rowIt != m_addressToRow.constEnd()) {
+                if (!result.isChanged(firstIndex, valueIndex - firstIndex)) {
+                    currentAddress += valueIndex - firstIndex;
+                    continue;
+                }
                 const int row = rowIt.value();
                 QTableWidgetItem *valueItem = ui->blockTableWidget->item(row, 2);
                 if (!valueItem) {
@@ -407,7 +436,7 @@ void BlockTableForm::insertRowBlockStatus(const BlockStatusEntry &entry)
     ui->detailTableWidget->setItem(row, 2, valueItem);
 }
 
-void BlockTableForm::requestValueByValue() const
+void BlockTableForm::requestValueByValue()
 {
     if (!m_modbusClient) {
         return;
@@ -416,19 +445,21 @@ void BlockTableForm::requestValueByValue() const
     for (const auto &entry : m_entries) {
         const int address = entry.address;
         QMetaObject::invokeMethod(m_modbusClient,
-                                  [client = m_modbusClient, address]() {
-                                      if (!client) {
+                                  [client = m_modbusClient, form = QPointer<BlockTableForm>(this), address]() {
+                                      if (!client || !form) {
                                           return;
                                       }
                                       client->readHoldingRegisters(address,
                                                                    address == BlockTableAddress::LaserControlBoardStatus ||
-                                                                           address == BlockTableAddress::PowerSupplyControlStatus ? 2 : 1);
+                                                                           address == BlockTableAddress::PowerSupplyControlStatus ? 2 : 1,
+                                                                   form,
+                                                                   {});
                                   },
                                   Qt::QueuedConnection);
     }
 }
 
-void BlockTableForm::requestAllValues() const
+void BlockTableForm::requestAllValues()
 {
     if (!m_modbusClient) {
         return;
@@ -439,15 +470,24 @@ void BlockTableForm::requestAllValues() const
     const int registerCount = BlockTableAddress::AddressTillOfEndBlocks - startAddress; // 0x11e-0x12c
 
     QMetaObject::invokeMethod(m_modbusClient,
-                              [client = m_modbusClient, startAddress, registerCount]() {
-                                  if (!client) {
+                              [client = m_modbusClient, form = QPointer<BlockTableForm>(this), startAddress, registerCount]() {
+                                  if (!client || !form) {
                                       return;
                                   }
-                                  client->readHoldingRegisters(startAddress, registerCount);
+                                  client->readHoldingRegisters(startAddress, registerCount, form, {});
                               },
                               Qt::QueuedConnection);
 }
 
+QVector<PollGroup> BlockTableForm::pollGroups() const
+{
+    return {
+        {BlockTableAddress::LaserControlBoardStatus,
+         BlockTableAddress::AddressTillOfEndBlocks - BlockTableAddress::LaserControlBoardStatus,
+         500},
+    };
+}
+
 void BlockTableForm::on_pushButton_clicked()
 {
     requestAllValues();
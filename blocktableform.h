@@ -28,11 +28,12 @@ public:
     QList<int> getSplitterSizes();
     void setSplitterSizes(const QList<int> &);
 
-    void requestValueByValue() const;
-    void requestAllValues() const override;
+    void requestValueByValue();
+    void requestAllValues() override;
+    QVector<PollGroup> pollGroups() const override;
 
 private slots:
-    void handleReadCompleted(int startAddress, const QVector<quint16> &values);
+    void handleReadCompleted(const ModbusResult &result);
     void showDetails(int address);
 
     void on_pushButton_clicked();
@@ -0,0 +1,239 @@
+#include "capturerecorder.h"
+#include "modbusclient.h"
+
+#include <QLoggingCategory>
+#include <QMutexLocker>
+#include <QTimer>
+
+namespace {
+QLoggingCategory lcCapture("modbus.capture");
+
+constexpr int kReportIntervalMs = 1000;
+// An interval this many times the smoothed one counts as a gap.
+constexpr int kGapFactor = 3;
+}
+
+CaptureBuffer::CaptureBuffer(int capacity)
+    : m_samples(qMax(1, capacity))
+{
+}
+
+void CaptureBuffer::append(CaptureSample sample)
+{
+    QMutexLocker locker(&m_lock);
+    sample.sequence = m_nextSequence++;
+    m_samples[int(sample.sequence % quint64(m_samples.size()))] = sample;
+}
+
+void CaptureBuffer::clear()
+{
+    QMutexLocker locker(&m_lock);
+    // Sequence numbers keep counting so readers holding a cursor are not confused.
+    const quint64 capacity = quint64(m_samples.size());
+    m_nextSequence += capacity - m_nextSequence % capacity;
+}
+
+QVector<CaptureSample> CaptureBuffer::samplesSince(quint64 &sequence) const
+{
+    QMutexLocker locker(&m_lock);
+    const quint64 capacity = quint64(m_samples.size());
+    const quint64 oldest = m_nextSequence > capacity ? m_nextSequence - capacity : 0;
+    sequence = qMax(sequence, oldest);
+
+    QVector<CaptureSample> samples;
+    samples.reserve(int(m_nextSequence > sequence ? m_nextSequence - sequence : 0));
+    for (; sequence < m_nextSequence; ++sequence) {
+        const CaptureSample &sample = m_samples.at(int(sequence % capacity));
+        if (sample.sequence == sequence) {
+            samples.append(sample);
+        }
+    }
+    return samples;
+}
+
+quint64 CaptureBuffer::nextSequence() const
+{
+    QMutexLocker locker(&m_lock);
+    return m_nextSequence;
+}
+
+CaptureRecorder::CaptureRecorder(ModbusClient *client, QObject *parent)
+    : QObject(parent)
+    , m_client(client)
+    , m_reportTimer(new QTimer(this))
+    , m_buffer(1 << 15)
+{
+    m_reportTimer->setInterval(kReportIntervalMs);
+    connect(m_reportTimer, &QTimer::timeout, this, [this]() {
+        reportStatistics();
+    });
+    // Reads stop while the link is down and resume once it is back.
+    connect(m_client, &ModbusClient::connectionStateChanged, this, [this](bool connected) {
+        if (!connected) {
+            return;
+        }
+        for (int i = 0; i < m_channels.size(); ++i) {
+            issue(i);
+        }
+    });
+}
+
+void CaptureRecorder::setRanges(const QVector<CaptureRange> &ranges)
+{
+    m_channels.clear();
+    ++m_generation;
+    for (const CaptureRange &range : ranges) {
+        if (range.numberOfEntries == 0 || range.numberOfEntries > CaptureSample::kMaxRegisters) {
+            qCWarning(lcCapture) << "Ignoring capture range at" << range.startAddress << "of"
+                                 << range.numberOfEntries << "registers";
+            continue;
+        }
+        Channel channel;
+        channel.range = range;
+        m_channels.append(channel);
+    }
+
+    if (m_running) {
+        for (int i = 0; i < m_channels.size(); ++i) {
+            issue(i);
+        }
+    }
+}
+
+void CaptureRecorder::setMinIntervalUs(int intervalUs)
+{
+    m_minIntervalUs = qMax(0, intervalUs);
+}
+
+int CaptureRecorder::minIntervalUs() const
+{
+    return m_minIntervalUs;
+}
+
+bool CaptureRecorder::isRunning() const
+{
+    return m_running;
+}
+
+const CaptureBuffer &CaptureRecorder::buffer() const
+{
+    return m_buffer;
+}
+
+void CaptureRecorder::start()
+{
+    if (m_running) {
+        return;
+    }
+
+    m_running = true;
+    ++m_generation;
+    m_samplesSinceReport = 0;
+    m_gaps = 0;
+    m_longestGapUs = 0;
+    m_buffer.clear();
+    m_reportClock.start();
+    m_reportTimer->start();
+    for (int i = 0; i < m_channels.size(); ++i) {
+        m_channels[i] = Channel{m_channels.at(i).range};
+        issue(i);
+    }
+    qCDebug(lcCapture) << "Capture started," << m_channels.size() << "ranges";
+}
+
+void CaptureRecorder::stop()
+{
+    if (!m_running) {
+        return;
+    }
+
+    m_running = false;
+    ++m_generation;
+    m_reportTimer->stop();
+    reportStatistics();
+    qCDebug(lcCapture) << "Capture stopped";
+}
+
+void CaptureRecorder::issue(int index)
+{
+    Channel &channel = m_channels[index];
+    if (!m_running || channel.pending || !m_client->isConnected()) {
+        return;
+    }
+
+    const qint64 nowUs = ModbusResult::monotonicUs();
+    const qint64 waitUs = channel.lastIssuedUs + m_minIntervalUs - nowUs;
+    if (channel.lastIssuedUs > 0 && waitUs > 0) {
+        channel.pending = true;
+        QTimer::singleShot(int((waitUs + 999) / 1000), Qt::PreciseTimer, this, [this, index, generation = m_generation]() {
+            if (generation != m_generation) {
+                return;
+            }
+            m_channels[index].pending = false;
+            issue(index);
+        });
+        return;
+    }
+
+    channel.pending = true;
+    channel.lastIssuedUs = nowUs;
+    m_client->readHoldingRegisters(channel.range.startAddress,
+                                   channel.range.numberOfEntries,
+                                   this,
+                                   [this, index, generation = m_generation](const ModbusResult &result) {
+                                       handleSample(index, generation, result);
+                                   },
+                                   1,
+                                   ModbusClient::ReadSource::Capture);
+}
+
+void CaptureRecorder::handleSample(int index, quint64 generation, const ModbusResult &result)
+{
+    if (generation != m_generation) {
+        return;
+    }
+
+    Channel &channel = m_channels[index];
+    channel.pending = false;
+    if (!result.isOk()) {
+        recordGap(result.receivedUs > 0 && channel.lastSampleUs > 0 ? result.receivedUs - channel.lastSampleUs : 0);
+        issue(index);
+        return;
+    }
+
+    CaptureSample sample;
+    sample.receivedUs = result.receivedUs;
+    sample.startAddress = result.startAddress;
+    sample.numberOfEntries = result.numberOfEntries;
+    for (int i = 0; i < result.values.size() && i < CaptureSample::kMaxRegisters; ++i) {
+        sample.values[i] = result.values.at(i);
+    }
+    m_buffer.append(sample);
+    ++m_samplesSinceReport;
+
+    if (channel.lastSampleUs > 0) {
+        const qint64 intervalUs = sample.receivedUs - channel.lastSampleUs;
+        if (channel.smoothedIntervalUs > 0 && intervalUs > kGapFactor * channel.smoothedIntervalUs) {
+            recordGap(intervalUs);
+        }
+        channel.smoothedIntervalUs = channel.smoothedIntervalUs > 0
+                                         ? channel.smoothedIntervalUs + (intervalUs - channel.smoothedIntervalUs) / 8
+                                         : intervalUs;
+    }
+    channel.lastSampleUs = sample.receivedUs;
+    issue(index);
+}
+
+void CaptureRecorder::recordGap(qint64 gapUs)
+{
+    ++m_gaps;
+    m_longestGapUs = qMax(m_longestGapUs, gapUs);
+}
+
+void CaptureRecorder::reportStatistics()
+{
+    const qint64 elapsedMs = m_reportClock.restart();
+    const double samplesPerSecond = elapsedMs > 0 ? m_samplesSinceReport * 1000.0 / elapsedMs : 0.0;
+    m_samplesSinceReport = 0;
+    emit statisticsChanged(samplesPerSecond, m_gaps, m_longestGapUs);
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QObject>
+#include <QVector>
+#include <QtGlobal>
+
+#include <array>
+
+class ModbusClient;
+struct ModbusResult;
+class QTimer;
+
+struct CaptureRange
+{
+    int startAddress = 0;
+    quint16 numberOfEntries = 0;
+};
+
+// One read of a capture range, stamped when the reply arrived.
+struct CaptureSample
+{
+    static constexpr int kMaxRegisters = 8;
+
+    quint64 sequence = 0;
+    qint64 receivedUs = 0;
+    int startAddress = 0;
+    quint16 numberOfEntries = 0;
+    std::array<quint16, kMaxRegisters> values{};
+};
+
+/**
+ * @brief Fixed size buffer of the latest capture samples, safe to use from any thread.
+ *
+ * Once full, each new sample replaces the oldest one.
+ */
+class CaptureBuffer
+{
+public:
+    explicit CaptureBuffer(int capacity);
+
+    void append(CaptureSample sample);
+    void clear();
+
+    // Samples with a sequence number of at least sequence, oldest first. sequence is
+    // moved past the last returned sample; samples already overwritten are skipped.
+    QVector<CaptureSample> samplesSince(quint64 &sequence) const;
+    quint64 nextSequence() const;
+
+private:
+    mutable QMutex m_lock;
+    QVector<CaptureSample> m_samples;
+    quint64 m_nextSequence = 0;
+};
+
+/**
+ * @brief Samples a few register ranges as fast as the link allows.
+ *
+ * Each range is read again as soon as its previous read is answered, but not more
+ * often than the minimum interval. Reads always go to the device and the samples
+ * are stored in buffer(), bypassing the forms. Lives in the Modbus thread.
+ */
+class CaptureRecorder : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit CaptureRecorder(ModbusClient *client, QObject *parent = nullptr);
+
+    void setRanges(const QVector<CaptureRange> &ranges);
+    void setMinIntervalUs(int intervalUs);
+    int minIntervalUs() const;
+
+    bool isRunning() const;
+    const CaptureBuffer &buffer() const;
+
+public slots:
+    void start();
+    void stop();
+
+signals:
+    // Once a second while running. A gap is a failed read or a sample that came more
+    // than kGapFactor times the usual interval after the previous one of its range.
+    void statisticsChanged(double samplesPerSecond, quint64 gaps, qint64 longestGapUs);
+
+private:
+    struct Channel
+    {
+        CaptureRange range;
+        bool pending = false;
+        qint64 lastIssuedUs = 0;
+        qint64 lastSampleUs = 0;
+        qint64 smoothedIntervalUs = 0;
+    };
+
+    void issue(int index);
+    void handleSample(int index, quint64 generation, const ModbusResult &result);
+    void recordGap(qint64 gapUs);
+    void reportStatistics();
+
+    ModbusClient *m_client = nullptr;
+    QTimer *m_reportTimer = nullptr;
+    QElapsedTimer m_reportClock;
+    QVector<Channel> m_channels;
+    CaptureBuffer m_buffer;
+    int m_minIntervalUs = 10000;
+    bool m_running = false;
+    // Replies to reads issued before the last start() or setRanges() are ignored.
+    quint64 m_generation = 0;
+    quint64 m_samplesSinceReport = 0;
+    quint64 m_gaps = 0;
+    qint64 m_longestGapUs = 0;
+};
@@ -0,0 +1,86 @@
+#include "connectionmanager.h"
+#include "modbusclient.h"
+
+#include <QLoggingCategory>
+#include <QRandomGenerator>
+#include <QTimer>
+
+namespace {
+QLoggingCategory lcConnection("modbus.connection");
+}
+
+ConnectionManager::ConnectionManager(ModbusClient *client, QObject *parent)
+    : QObject(parent)
+    , m_client(client)
+    , m_reconnectTimer(new QTimer(this))
+{
+    m_reconnectTimer->setSingleShot(true);
+    connect(m_reconnectTimer, &QTimer::timeout, this, [this]() {
+        attemptConnect();
+    });
+    connect(m_client, &ModbusClient::connectionStateChanged, this, &ConnectionManager::onConnectionStateChanged);
+}
+
+void ConnectionManager::setBackoff(int initialDelayMs, int maxDelayMs)
+{
+    m_initialDelayMs = qMax(1, initialDelayMs);
+    m_maxDelayMs = qMax(m_initialDelayMs, maxDelayMs);
+}
+
+void ConnectionManager::connectTo(const QString &host, quint16 port)
+{
+    m_host = host;
+    m_port = port;
+    m_wantConnected = true;
+    m_attempt = 0;
+    m_reconnectTimer->stop();
+    attemptConnect();
+}
+
+void ConnectionManager::disconnectFrom()
+{
+    m_wantConnected = false;
+    m_reconnectTimer->stop();
+    m_client->disconnectDevice();
+}
+
+void ConnectionManager::onConnectionStateChanged(bool connected)
+{
+    if (connected) {
+        m_attempt = 0;
+        m_reconnectTimer->stop();
+        return;
+    }
+
+    if (m_wantConnected && !m_reconnectTimer->isActive()) {
+        scheduleReconnect();
+    }
+}
+
+void ConnectionManager::scheduleReconnect()
+{
+    int delayMs = 0;
+    if (m_attempt > 0) {
+        // Capped exponential backoff with up to 25% jitter.
+        const int exponent = qMin(m_attempt - 1, 20);
+        delayMs = int(qMin<qint64>(qint64(m_initialDelayMs) << exponent, m_maxDelayMs));
+        delayMs += int(QRandomGenerator::global()->bounded(delayMs / 4 + 1));
+    }
+    ++m_attempt;
+
+    qCDebug(lcConnection) << "Reconnect attempt" << m_attempt << "to" << m_host << ":" << m_port
+                          << "in" << delayMs << "ms";
+    emit reconnectScheduled(m_attempt, delayMs);
+    m_reconnectTimer->start(delayMs);
+}
+
+void ConnectionManager::attemptConnect()
+{
+    if (!m_wantConnected || m_client->isConnected()) {
+        return;
+    }
+
+    if (!m_client->connectDevice(m_host, m_port)) {
+        scheduleReconnect();
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <QObject>
+#include <QString>
+
+class ModbusClient;
+class QTimer;
+
+/**
+ * @brief Keeps ModbusClient connected to the requested device.
+ *
+ * Lives in the Modbus thread next to the client. After the connection is lost it
+ * reconnects with capped exponential backoff and never gives up until told to
+ * disconnect.
+ */
+class ConnectionManager : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ConnectionManager(ModbusClient *client, QObject *parent = nullptr);
+
+    // Delay before the second attempt, doubled per failed attempt up to maxDelayMs.
+    // The first attempt after a drop is made immediately.
+    void setBackoff(int initialDelayMs, int maxDelayMs);
+
+public slots:
+    void connectTo(const QString &host, quint16 port);
+    void disconnectFrom();
+
+signals:
+    void reconnectScheduled(int attempt, int delayMs);
+
+private:
+    void onConnectionStateChanged(bool connected);
+    void scheduleReconnect();
+    void attemptConnect();
+
+    ModbusClient *m_client = nullptr;
+    QTimer *m_reconnectTimer = nullptr;
+    QString m_host;
+    quint16 m_port = 502;
+    bool m_wantConnected = false;
+    int m_attempt = 0;
+    int m_initialDelayMs = 100;
+    int m_maxDelayMs = 5000;
+};
@@ -1,20 +1,54 @@
 #include "controller.h"
+#include "connectionmanager.h"
+#include "pollscheduler.h"
+#include "capturerecorder.h"
 #include "enums.h"
 #include "endianutils.h"
 
 #include <QDebug>
 
+namespace {
+// Room for the few PollScheduler reads that fall due in one tick, plus a capture read
+// and an operator write, so neither waits behind a tick's polls.
+constexpr int kModbusPipelineDepth = 5;
+// Lets several docks showing the same registers share one read.
+constexpr int kRegisterCacheMaxAgeMs = 100;
+// Probe a silent link often enough to notice a dead laser within a few hundred ms.
+constexpr int kHeartbeatIntervalMs = 200;
+// Mode and generator toggles issued together go out as one FC16 request.
+constexpr int kWriteCombiningWindowUs = 2000;
+// Pump sync diagnostics want 50-100 samples per second.
+constexpr int kCaptureMinIntervalUs = 10000;
+}
+
 Controller::Controller(QObject *parent)
     : QObject{parent}
 {
     m_modebusClient = new ModbusClient;
+    m_modebusClient->setMaxInFlightRequests(kModbusPipelineDepth);
+    m_modebusClient->setCacheMaxAgeMs(kRegisterCacheMaxAgeMs);
+    m_modebusClient->setHeartbeat(kHeartbeatIntervalMs);
+    m_modebusClient->setWriteCombiningWindowUs(kWriteCombiningWindowUs);
+    // Falls back to separate requests by itself if the laser rejects FC23.
+    m_modebusClient->setReadWriteFusion(true);
+    // Created before moveToThread so it follows the client into the Modbus thread.
+    m_connectionManager = new ConnectionManager(m_modebusClient, m_modebusClient);
+    m_pollScheduler = new PollScheduler(m_modebusClient, m_modebusClient);
+    m_captureRecorder = new CaptureRecorder(m_modebusClient, m_modebusClient);
+    m_captureRecorder->setMinIntervalUs(kCaptureMinIntervalUs);
+    m_captureRecorder->setRanges({
+        {SensorsTableAddress::FrequencyIncomingSyncPulses_1,
+         SensorsTableAddress::FrequencyIncomingSyncPulses_3 + 2 - SensorsTableAddress::FrequencyIncomingSyncPulses_1},
+        {SensorsTableAddress::BoardOperatingMode, 2},
+        {SensorsTableAddress::LaserPower, 2},
+    });
     m_modebusClientThread = new QThread(this);
     m_modebusClient->moveToThread(m_modebusClientThread);
     // Ensure the controller lives in the worker thread and is deleted there
     m_modebusClient->connect(m_modebusClientThread, &QThread::finished, m_modebusClient, &QObject::deleteLater);
     m_modebusClientThread->start();
-    connect(this, &Controller::connectToTcpPort, m_modebusClient, &ModbusClient::connectDevice, Qt::QueuedConnection);
-    connect(this, &Controller::disconnectFromTcp, m_modebusClient, &ModbusClient::disconnectDevice, Qt::QueuedConnection);
+    connect(this, &Controller::connectToTcpPort, m_connectionManager, &ConnectionManager::connectTo, Qt::QueuedConnection);
+    connect(this, &Controller::disconnectFromTcp, m_connectionManager, &ConnectionManager::disconnectFrom, Qt::QueuedConnection);
     connect(m_modebusClient,  &ModbusClient::connectionStateChanged, this, [this](bool connected){
     //     if (m_tcpConnected == connected) return;
     //     m_tcpConnected = connected;
@@ -39,6 +73,16 @@ ModbusClient *Controller::modbusClient() const
     return m_modebusClient;
 }
 
+PollScheduler *Controller::pollScheduler() const
+{
+    return m_pollScheduler;
+}
+
+CaptureRecorder *Controller::captureRecorder() const
+{
+    return m_captureRecorder;
+}
+
 void Controller::sendMessageForMode(Mode mode)
 {
     emit sendMessage(ModeAddress::ManualAddress, toLittleEndian(quint16(mode)));
@@ -7,6 +7,10 @@
 #include "enums.h"
 #include "modbusclient.h"
 
+class ConnectionManager;
+class PollScheduler;
+class CaptureRecorder;
+
 class Controller : public QObject
 {
     Q_OBJECT
@@ -15,6 +19,8 @@ public:
     ~Controller();
 
     ModbusClient *modbusClient() const;
+    PollScheduler *pollScheduler() const;
+    CaptureRecorder *captureRecorder() const;
 
 public slots:
     void sendMessageForMode(Mode mode);
@@ -28,6 +34,9 @@ signals:
 
 private:
     ModbusClient *m_modebusClient = nullptr;
+    ConnectionManager *m_connectionManager = nullptr;
+    PollScheduler *m_pollScheduler = nullptr;
+    CaptureRecorder *m_captureRecorder = nullptr;
     QThread *m_modebusClientThread = nullptr;
 };
 
@@ -5,6 +5,8 @@
 #include "limitandtargetvaluesform.h"
 #include "generatorsetterform.h"
 #include "modbusclient.h"
+#include "pollscheduler.h"
+#include "capturerecorder.h"
 #include "git_version.h"
 
 #include <QDockWidget>
@@ -25,6 +27,9 @@
 #include <QPushButton>
 #include <QDebug>
 #include <QTimer>
+#include <QSet>
+
+#include <algorithm>
 
 #ifdef Q_OS_WIN
 #include <qt_windows.h>
@@ -48,19 +53,6 @@ DockManager::DockManager(QWidget *parent)
     ));
      
     // createUi();
-    m_requestAllTimer = new QTimer(this);
-    m_requestAllTimer->setSingleShot(false);
-    m_requestAllTimer->setTimerType(Qt::PreciseTimer);
-    connect(m_requestAllTimer, &QTimer::timeout, [this](){
-        requestAllValues();
-    });
-
-    m_reconnectionTimer = new QTimer(this);
-    m_reconnectionTimer->setSingleShot(true);
-    connect(m_reconnectionTimer, &QTimer::timeout, [this](){
-        attemptReconnection();
-    });
-
     createActions();
     createMenusAndToolbars();
 
@@ -83,6 +75,28 @@ DockManager::DockManager(QWidget *parent)
     // });
 }
 
+void DockManager::setPollScheduler(PollScheduler *scheduler)
+{
+    if (m_pollScheduler == scheduler) {
+        return;
+    }
+
+    if (m_pollScheduler) {
+        disconnect(m_pollScheduler, nullptr, this, nullptr);
+    }
+    m_pollScheduler = scheduler;
+    if (!m_pollScheduler) {
+        return;
+    }
+
+    connect(m_pollScheduler, &PollScheduler::frameReady, this, &DockManager::onPollFrameReady);
+
+    updatePollScheduler();
+    for (const PollConsumer &consumer : std::as_const(m_consumers)) {
+        registerPollGroups(consumer);
+    }
+}
+
 void DockManager::setModbusClient(ModbusClient *client)
 {
     if (m_modbusClient == client) {
@@ -94,22 +108,24 @@ void DockManager::setModbusClient(ModbusClient *client)
     }
 
     m_modbusClient = client;
-    const auto widgets = findChildren<QWidget*>();
-    for (auto *widget : widgets) {
-        if (auto *form = dynamic_cast<ModbusBase*>(widget)) {
-            form->setModbusClient(m_modbusClient);
-        }
-        if (auto *form = dynamic_cast<SensorsTableForm*>(widget)) {
-            qDebug() << "SensorsTableForm";
-        }
-        if (auto *form = dynamic_cast<LimitAndTargetValuesForm*>(widget)) {
-            qDebug() << "LimitAndTargetValuesForm";
-        }
+    for (const PollConsumer &consumer : std::as_const(m_consumers)) {
+        consumer.form->setModbusClient(m_modbusClient);
     }
 
     if (m_modbusClient) {
+        toggleNativeModbus(m_actNativeModbus->isChecked());
         connect(m_modbusClient, &ModbusClient::connectionStateChanged, this, &DockManager::onConnectionStateChanged);
+        connect(m_modbusClient, &ModbusClient::roundTripTimeChanged, this, &DockManager::onRoundTripTimeChanged);
+        connect(m_modbusClient, &ModbusClient::firstDataAfterConnect, this, [this](int timeToFirstDataMs) {
+            if (m_connectionStatusLabel) {
+                m_connectionStatusLabel->setToolTip(tr("Первые данные через %1 мс после подключения").arg(timeToFirstDataMs));
+            }
+        });
         onConnectionStateChanged(m_modbusClient->isConnected());
+        // Reconnects after a drop are handled by ConnectionManager in the Modbus thread.
+        if (!m_isConnected) {
+            toggleConnect(false);
+        }
     } else {
         onConnectionStateChanged(false);
     }
@@ -151,6 +167,17 @@ void DockManager::createActions()
     m_actShowTitles->setChecked(true);
     connect(m_actShowTitles, &QAction::toggled, this, &DockManager::toggleDockTitles);
 
+    m_actNativeModbus = new QAction(tr("Собственный стек Modbus TCP"), this);
+    m_actNativeModbus->setCheckable(true);
+    m_actNativeModbus->setChecked(QSettings(settingsOrg(), settingsApp()).value("modbus/nativeEngine", false).toBool());
+    connect(m_actNativeModbus, &QAction::toggled, this, &DockManager::toggleNativeModbus);
+
+    m_actCapture = new QAction(tr("Захват"), this);
+    m_actCapture->setCheckable(true);
+    m_actCapture->setEnabled(false);
+    m_actCapture->setToolTip(tr("Частый опрос частоты синхроимпульсов, мощности и режима"));
+    connect(m_actCapture, &QAction::toggled, this, &DockManager::toggleCapture);
+
     m_actSaveLayout = new QAction(tr("Сохранить раскладку"), this);
     connect(m_actSaveLayout, &QAction::triggered, this, &DockManager::saveLayout);
 
@@ -176,6 +203,10 @@ void DockManager::createMenusAndToolbars()
     m_viewMenu = menuBar()->addMenu(tr("Вид"));
     m_viewMenu->addAction(m_actShowTitles);
 
+    m_connectionMenu = menuBar()->addMenu(tr("Соединение"));
+    m_connectionMenu->addAction(m_actNativeModbus);
+    m_connectionMenu->addAction(m_actCapture);
+
     m_windowMenu = menuBar()->addMenu(tr("Окна"));
     m_windowMenu->addAction(m_actAddModeControl);
     m_windowMenu->addAction(m_actAddSensorTable);
@@ -212,6 +243,12 @@ void DockManager::createMenusAndToolbars()
             "}"
             ));
         m_mainToolbar->addWidget(m_connectionStatusLabel);
+
+        m_roundTripLabel = new QLabel(this);
+        m_roundTripLabel->setMinimumWidth(150);
+        m_roundTripLabel->setAlignment(Qt::AlignCenter);
+        m_roundTripLabel->setToolTip(tr("Время отклика устройства и текущий таймаут ответа"));
+        m_mainToolbar->addWidget(m_roundTripLabel);
         // m_mainToolbar->addWidget(m_gitTagLabel);
 
         // auto *spacer = new QWidget(this);
@@ -224,7 +261,8 @@ void DockManager::createMenusAndToolbars()
     auto comboBox = new QComboBox(this);
     comboBox->addItems({"0.5", "1", "2", "3", "4", "5"});
     connect(comboBox, &QComboBox::currentTextChanged, [this](const QString &text){
-        m_requestAllTimer->setInterval(text.toFloat() * 1000);
+        m_pollBasePeriodMs = qRound(text.toFloat() * 1000);
+        updatePollScheduler();
     });
     comboBox->setCurrentText("1");
     m_mainToolbar->addWidget(comboBox);
@@ -234,6 +272,18 @@ void DockManager::createMenusAndToolbars()
     startStopButton();
     connect(m_startStopButton, &QPushButton::clicked, this, &DockManager::startStopButton);
     m_mainToolbar->addWidget(m_startStopButton);
+    m_frameLabel = new QLabel(this);
+    m_frameLabel->setMinimumWidth(150);
+    m_frameLabel->setAlignment(Qt::AlignCenter);
+    m_mainToolbar->addWidget(m_frameLabel);
+
+    m_mainToolbar->addSeparator();
+    m_mainToolbar->addAction(m_actCapture);
+    m_captureLabel = new QLabel(this);
+    m_captureLabel->setMinimumWidth(150);
+    m_captureLabel->setAlignment(Qt::AlignCenter);
+    m_captureLabel->setToolTip(tr("Достигнутая частота выборок захвата и пропуски"));
+    m_mainToolbar->addWidget(m_captureLabel);
 
     m_mainToolbar->addSeparator();
     m_mainToolbar->addAction(m_actAddModeControl);
@@ -339,6 +389,67 @@ void DockManager::toggleConnect(bool /*on*/)
     }
 }
 
+void DockManager::onRoundTripTimeChanged(int smoothedRttUs, int rttVariationUs, int replyTimeoutMs)
+{
+    if (!m_roundTripLabel) {
+        return;
+    }
+    m_roundTripLabel->setText(tr("RTT %1 ± %2 мс, таймаут %3 мс")
+                                  .arg(smoothedRttUs / 1000.0, 0, 'f', 1)
+                                  .arg(rttVariationUs / 1000.0, 0, 'f', 1)
+                                  .arg(replyTimeoutMs));
+}
+
+void DockManager::onPollFrameReady(const PollFramePtr &frame)
+{
+    if (!m_frameLabel || !frame) {
+        return;
+    }
+
+    // A period no dock polls any more stops producing frames; drop it once it is stale.
+    m_latestFrames.insert(frame->periodMs, frame);
+    const qint64 nowUs = ModbusResult::monotonicUs();
+    for (auto it = m_latestFrames.begin(); it != m_latestFrames.end();) {
+        const qint64 periodUs = qint64(it.key()) * m_pollBasePeriodMs;
+        if (nowUs - it.value()->completedUs > 3 * periodUs) {
+            it = m_latestFrames.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    QStringList passes;
+    QStringList details;
+    for (const PollFramePtr &latest : std::as_const(m_latestFrames)) {
+        int readRanges = 0;
+        for (const PollFrame::Range &range : latest->ranges) {
+            if (range.status == ModbusResult::Ok) {
+                ++readRanges;
+            }
+        }
+        passes.append(QStringLiteral("%1/%2").arg(readRanges).arg(latest->ranges.size()));
+        details.append(tr("Период %1 мс: проход %2, прочитано %3 из %4 за %5 мс")
+                           .arg(latest->periodMs)
+                           .arg(latest->sequence)
+                           .arg(readRanges)
+                           .arg(latest->ranges.size())
+                           .arg((latest->completedUs - latest->startedUs) / 1000.0, 0, 'f', 1));
+    }
+    m_frameLabel->setText(passes.join(QStringLiteral(" · ")));
+    m_frameLabel->setToolTip(details.join(QLatin1Char('\n')));
+}
+
+void DockManager::onCaptureStatisticsChanged(double samplesPerSecond, quint64 gaps, qint64 longestGapUs)
+{
+    if (!m_captureLabel || !m_actCapture->isChecked()) {
+        return;
+    }
+    m_captureLabel->setText(tr("%1 выб/с, пропусков %2 (до %3 мс)")
+                                .arg(samplesPerSecond, 0, 'f', 1)
+                                .arg(gaps)
+                                .arg(longestGapUs / 1000.0, 0, 'f', 1));
+}
+
 void DockManager::onConnectionStateChanged(bool connected)
 {
     m_isConnected = connected;
@@ -372,13 +483,12 @@ void DockManager::onConnectionStateChanged(bool connected)
         );
     }
 
+    if (m_roundTripLabel && !connected) {
+        m_roundTripLabel->clear();
+    }
+
     if (connected) {
-        // При успешном подключении сбрасываем счетчик попыток
-        m_reconnectionAttempts = 0;
         requestAllValues();
-    } else {
-        // При разрыве соединения начинаем попытки переподключения
-        startReconnectionAttempts();
     }
 }
 
@@ -388,22 +498,85 @@ void DockManager::startStopButton()
     {
         m_startStopButton->setIcon(QIcon("://icons/start-on.svg"));
         m_startStopButton->setToolTip("Старт");
-        m_requestAllTimer->stop();
     }
     else
     {
         m_startStopButton->setIcon(QIcon("://icons/stop-on.svg"));
         m_startStopButton->setToolTip("Стоп");
-        m_requestAllTimer->start();
     }
     m_isStartedPool = !m_isStartedPool;
+    updatePollScheduler();
+}
+
+void DockManager::updatePollScheduler()
+{
+    if (!m_pollScheduler) {
+        return;
+    }
+
+    // m_isStartedPool is set while the button offers to start polling.
+    QMetaObject::invokeMethod(m_pollScheduler,
+                              [scheduler = m_pollScheduler, basePeriodMs = m_pollBasePeriodMs, running = !m_isStartedPool]() {
+                                  scheduler->setBasePeriodMs(basePeriodMs);
+                                  if (running) {
+                                      scheduler->start();
+                                  } else {
+                                      scheduler->stop();
+                                  }
+                              },
+                              Qt::QueuedConnection);
+}
+
+void DockManager::registerPollGroups(const PollConsumer &consumer)
+{
+    if (!m_pollScheduler) {
+        return;
+    }
+
+    QMetaObject::invokeMethod(m_pollScheduler,
+                              [scheduler = m_pollScheduler,
+                               owner = static_cast<QObject*>(consumer.dock->widget()),
+                               groups = consumer.form->pollGroups(),
+                               enabled = consumer.active]() {
+                                  scheduler->setGroups(owner, groups, enabled);
+                              },
+                              Qt::QueuedConnection);
 }
 
 void DockManager::connectDockSignals(QDockWidget *dock)
 {
     if (!dock) return;
-    connect(dock, &QDockWidget::visibilityChanged, this, [this](bool){ updateActionChecks(); });
-    connect(dock, &QObject::destroyed, this, [this](QObject*){ updateActionChecks(); });
+    attachConsumer(dock);
+    connect(dock, &QDockWidget::visibilityChanged, this, [this, dock](bool visible){
+        updateActionChecks();
+        PollConsumer *consumer = findConsumer(dock);
+        if (consumer) {
+            consumer->active = visible;
+        }
+        if (m_pollScheduler && consumer) {
+            QMetaObject::invokeMethod(m_pollScheduler,
+                                      [scheduler = m_pollScheduler, owner = static_cast<QObject*>(dock->widget()), visible]() {
+                                          scheduler->setOwnerEnabled(owner, visible);
+                                      },
+                                      Qt::QueuedConnection);
+        }
+        // Slow groups may not come due for a while, refresh a dock as it is shown.
+        if (visible && m_isConnected && consumer) {
+            consumer->form->requestAllValues();
+        }
+        if (!visible && m_modbusClient && dock->widget()) {
+            // Nobody will look at the replies of a hidden dock's pending reads.
+            QMetaObject::invokeMethod(m_modbusClient,
+                                      [client = m_modbusClient, owner = static_cast<QObject*>(dock->widget())]() {
+                                          client->cancelRequests(owner);
+                                      },
+                                      Qt::QueuedConnection);
+        }
+    });
+    connect(dock, &QObject::destroyed, this, [this](QObject *object){
+        detachConsumer(object);
+        updateActionChecks();
+    });
         connect(dock, &QDockWidget::topLevelChanged, [dock](bool floating) {
         if (floating) {
             // Defer the native window modifications to ensure the window handle is valid
@@ -524,6 +697,47 @@ void DockManager::toggleDockTitles(bool show)
     for (auto *dock : docks) dock->setTitleBarWidget(show ? nullptr : new QWidget(dock));
 }
 
+void DockManager::setCaptureRecorder(CaptureRecorder *recorder)
+{
+    if (m_captureRecorder == recorder) {
+        return;
+    }
+
+    if (m_captureRecorder) {
+        disconnect(m_captureRecorder, nullptr, this, nullptr);
+    }
+    m_captureRecorder = recorder;
+    m_actCapture->setEnabled(m_captureRecorder != nullptr);
+    if (m_captureRecorder) {
+        connect(m_captureRecorder, &CaptureRecorder::statisticsChanged, this, &DockManager::onCaptureStatisticsChanged);
+    }
+}
+
+void DockManager::toggleCapture(bool on)
+{
+    if (!m_captureRecorder) {
+        return;
+    }
+
+    if (!on) {
+        m_captureLabel->clear();
+    }
+    QMetaObject::invokeMethod(m_captureRecorder, on ? &CaptureRecorder::start : &CaptureRecorder::stop, Qt::QueuedConnection);
+}
+
+void DockManager::toggleNativeModbus(bool on)
+{
+    QSettings(settingsOrg(), settingsApp()).setValue("modbus/nativeEngine", on);
+    if (!m_modbusClient) {
+        return;
+    }
+
+    const auto engine = on ? ModbusClient::Engine::Native : ModbusClient::Engine::QtSerialBus;
+    QMetaObject::invokeMethod(m_modbusClient, [client = m_modbusClient, engine]() {
+        client->setEngine(engine);
+    }, Qt::QueuedConnection);
+}
+
 void DockManager::saveDockContents(QSettings &settings)
 {
     settings.beginGroup("docks");
@@ -605,13 +819,51 @@ QWidget* DockManager::createWidgetFromType(const QString &typeName, const QVaria
     return fallback;
 }
 
+void DockManager::attachConsumer(QDockWidget *dock)
+{
+    auto *form = dynamic_cast<ModbusBase*>(dock->widget());
+    if (!form || findConsumer(dock)) {
+        return;
+    }
+
+    PollConsumer consumer;
+    consumer.dock = dock;
+    consumer.form = form;
+    consumer.type = detectDockType(dock->widget());
+    consumer.active = dock->isVisible();
+    m_consumers.append(consumer);
+    registerPollGroups(consumer);
+}
+
+void DockManager::detachConsumer(QObject *dock)
+{
+    // Called from destroyed(): dock is only compared.
+    m_consumers.erase(std::remove_if(m_consumers.begin(), m_consumers.end(),
+                                     [dock](const PollConsumer &consumer) {
+                                         return consumer.dock == dock;
+                                     }),
+                      m_consumers.end());
+}
+
+DockManager::PollConsumer *DockManager::findConsumer(const QObject *dock)
+{
+    for (PollConsumer &consumer : m_consumers) {
+        if (consumer.dock == dock) {
+            return &consumer;
+        }
+    }
+    return nullptr;
+}
+
 void DockManager::requestAllValues()
 {
-    const auto widgets = findChildren<QWidget*>();
-    for (auto *widget : widgets) {
-        if (auto *form = dynamic_cast<ModbusBase*>(widget)) {
-            if (widget->isVisible())
-                form->requestAllValues();
+    // Forms of one type read the same registers and all of them are fed through their
+    // subscriptions, so one request per type is enough.
+    QSet<QString> requestedTypes;
+    for (const PollConsumer &consumer : std::as_const(m_consumers)) {
+        if (consumer.active && !requestedTypes.contains(consumer.type)) {
+            requestedTypes.insert(consumer.type);
+            consumer.form->requestAllValues();
         }
     }
 }
@@ -722,52 +974,6 @@ void DockManager::relayoutGrid(bool cascade)
     }
 }
 
-void DockManager::startReconnectionAttempts()
-{
-    // Останавливаем предыдущий таймер, если он активен
-    if (m_reconnectionTimer->isActive()) {
-        m_reconnectionTimer->stop();
-    }
-
-    // Если превысили максимальное количество попыток, прекращаем
-    if (m_reconnectionAttempts >= MAX_RECONNECTION_ATTEMPTS) {
-        qWarning() << "Превышено максимальное количество попыток переподключения:" << MAX_RECONNECTION_ATTEMPTS;
-        return;
-    }
-
-    static const int kReconnectDelaysMs[] = {0, 300, 700, 1500, 3000, 5000, 8000, 12000, 16000, 20000};
-    static const int kReconnectDelaysCount = int(sizeof(kReconnectDelaysMs) / sizeof(kReconnectDelaysMs[0]));
-
-    const int attemptNumber = m_reconnectionAttempts + 1;
-    const int delayIndex = qMin(m_reconnectionAttempts, kReconnectDelaysCount - 1);
-    const int delayMs = kReconnectDelaysMs[delayIndex];
-
-    m_reconnectionAttempts++;
-
-    qDebug() << "Попытка переподключения" << attemptNumber << "из" << MAX_RECONNECTION_ATTEMPTS
-             << "через" << delayMs << "мс";
-
-    m_reconnectionTimer->start(delayMs);
-}
-
-void DockManager::attemptReconnection()
-{
-    // Проверяем, не подключены ли мы уже
-    if (m_isConnected) {
-        m_reconnectionAttempts = 0; // Сбрасываем счетчик при успешном подключении
-        return;
-    }
-
-    // Если превысили максимальное количество попыток, прекращаем
-    if (m_reconnectionAttempts >= MAX_RECONNECTION_ATTEMPTS) {
-        qWarning() << "Превышено максимальное количество попыток переподключения";
-        return;
-    }
-
-    qDebug() << "Выполняем попытку переподключения" << m_reconnectionAttempts;
-    toggleConnect(false);
-}
-
 void DockManager::closeEvent(QCloseEvent *event)
 {
     // saveLayout(); bad way
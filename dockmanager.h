@@ -2,11 +2,17 @@
 #define DOCKMANAGER_H
 
 #include <QMainWindow>
+#include <QMap>
+#include <QVector>
 #include <qpushbutton.h>
 
 #include "enums.h"
+#include "snapshotassembler.h"
 
 class ModbusClient;
+class ModbusBase;
+class PollScheduler;
+class CaptureRecorder;
 class QMenu;
 class QToolBar;
 class QDockWidget;
@@ -22,6 +28,8 @@ class DockManager : public QMainWindow
 public:
     explicit DockManager(QWidget *parent = nullptr);
     void setModbusClient(ModbusClient *client);
+    void setPollScheduler(PollScheduler *scheduler);
+    void setCaptureRecorder(CaptureRecorder *recorder);
 
 signals:
     void modeRequested(Mode mode);
@@ -43,12 +51,17 @@ private slots:
     void toggleValueTable(bool on);
     void toggleGeneratorTable(bool on);
     void toggleDockTitles(bool show);
+    void toggleNativeModbus(bool on);
+    void toggleCapture(bool on);
     void saveLayout();
     void restoreLayout();
     void tileDocks();
     void cascadeDocks();
     void closeAllDocks();
     void onConnectionStateChanged(bool connected);
+    void onRoundTripTimeChanged(int smoothedRttUs, int rttVariationUs, int replyTimeoutMs);
+    void onPollFrameReady(const PollFramePtr &frame);
+    void onCaptureStatisticsChanged(double samplesPerSecond, quint64 gaps, qint64 longestGapUs);
     void startStopButton();
 
 private:
@@ -65,17 +78,36 @@ private:
     QString detectDockType(QWidget *content) const;
     QWidget* createWidgetFromType(const QString &typeName, const QVariant &payload);
     void requestAllValues();
-    void startReconnectionAttempts();
-    void attemptReconnection();
+    void updatePollScheduler();
+    struct PollConsumer;
+    void registerPollGroups(const PollConsumer &consumer);
+    void attachConsumer(QDockWidget *dock);
+    void detachConsumer(QObject *dock);
+    PollConsumer *findConsumer(const QObject *dock);
 
 private:
+    // A dock whose form reads from the device; active while the dock is shown.
+    struct PollConsumer
+    {
+        QDockWidget *dock = nullptr;
+        ModbusBase *form = nullptr;
+        QString type;
+        bool active = false;
+    };
+
     QMenu *m_fileMenu = nullptr;
     QMenu *m_viewMenu = nullptr;
     QMenu *m_windowMenu = nullptr;
+    QMenu *m_connectionMenu = nullptr;
     QMenu *m_versionMenu = nullptr;
     QToolBar *m_mainToolbar = nullptr;
     QPushButton *m_buttonConnect = nullptr;
     QLabel *m_connectionStatusLabel = nullptr;
+    QLabel *m_roundTripLabel = nullptr;
+    QLabel *m_captureLabel = nullptr;
+    QLabel *m_frameLabel = nullptr;
+    // Newest poll frame of each period, by nominal period.
+    QMap<int, PollFramePtr> m_latestFrames;
     QLabel *m_gitTagLabel = nullptr;
     QAction *m_actAddSensorTable = nullptr;
     QAction *m_actAddBlockTable = nullptr;
@@ -83,20 +115,22 @@ private:
     QAction *m_actAddValuesTable = nullptr;
     QAction *m_actAddGeneratorTable = nullptr;
     QAction *m_actShowTitles = nullptr;
+    QAction *m_actNativeModbus = nullptr;
+    QAction *m_actCapture = nullptr;
     QAction *m_actSaveLayout = nullptr;
     QAction *m_actRestoreLayout = nullptr;
     QAction *m_actTile = nullptr;
     QAction *m_actCascade = nullptr;
     QAction *m_actCloseAll = nullptr;
     int m_dockCounter = 0;
+    QVector<PollConsumer> m_consumers;
     ModbusClient *m_modbusClient = nullptr;
     bool m_isConnected = false;
-    QTimer *m_requestAllTimer = nullptr;
+    PollScheduler *m_pollScheduler = nullptr;
+    CaptureRecorder *m_captureRecorder = nullptr;
+    int m_pollBasePeriodMs = 1000;
     bool m_isStartedPool = false;
     QPushButton *m_startStopButton = nullptr;
-    QTimer *m_reconnectionTimer = nullptr;
-    int m_reconnectionAttempts = 0;
-    const int MAX_RECONNECTION_ATTEMPTS = 10;
 };
 
 #endif // DOCKMANAGER_H
@@ -44,25 +44,45 @@ void GeneratorSetterForm::setModbusClient(ModbusClient *client)
     }
 
     if (m_modbusClient) {
-        disconnect(m_modbusClient, &ModbusClient::readCompleted,
-                   this, &GeneratorSetterForm::handleReadCompleted);
-        disconnect(m_modbusClient, &ModbusClient::writeCompleted,
-                   this, &GeneratorSetterForm::handleWriteCompleted);
+        QMetaObject::invokeMethod(m_modbusClient,
+                                  [oldClient = m_modbusClient, form = static_cast<QObject *>(this)]() {
+                                      oldClient->unsubscribe(form);
+                                  },
+                                  Qt::QueuedConnection);
     }
-
     m_modbusClient = client;
-
-    if (m_modbusClient) {
-        connect(m_modbusClient, &ModbusClient::readCompleted,
-                this, &GeneratorSetterForm::handleReadCompleted);
-        connect(m_modbusClient, &ModbusClient::writeCompleted,
-                this, &GeneratorSetterForm::handleWriteCompleted);
-        // requestAllValues();
+    if (!m_modbusClient) {
+        return;
     }
+
+    // Every read covering the form's registers is routed here, whoever requested it.
+    QMetaObject::invokeMethod(m_modbusClient,
+                              [client = m_modbusClient, form = QPointer<GeneratorSetterForm>(this)]() {
+                                  if (!client || !form) {
+                                      return;
+                                  }
+                                  const auto onRead = [form](const ModbusResult &result) {
+                                      form->handleReadCompleted(result);
+                                  };
+                                  client->subscribe(GeneratorSetterAddress::TermoStableOnOff,
+                                                    GeneratorSetterAddress::AddressTillOfEndGenerator - GeneratorSetterAddress::TermoStableOnOff,
+                                                    form,
+                                                    onRead,
+                                                    1,
+                                                    SubscriptionRouter::ChangesOnly);
+                              },
+                              Qt::QueuedConnection);
 }
 
-void GeneratorSetterForm::handleReadCompleted(int startAddress, const QVector<quint16> &values)
+void GeneratorSetterForm::handleReadCompleted(const ModbusResult &result)
 {
+    if (!result.isOk()) {
+        return;
+    }
+
+    const int startAddress = result.startAddress;
+    const RegisterSlice &values = result.values;
+
     if (m_addressToRow.constFind(startAddress) != m_addressToRow.constEnd())
     {
         qDebug() << "Received" << values.size() << "registers starting from" << startAddress;
@@ -90,6 +110,7 @@ void GeneratorSetterForm::handleReadCompleted(int startAddress, const QVector<qu
 
             // Process the value(s) at current address
             std::variant<quint16, float> value;
+            const int firstIndex = valueIndex;
             if (relativeAddress == (GeneratorSetterAddress::TermoStableOnOff - baseAddress) ||
                 relativeAddress == (GeneratorSetterAddress::ImpulseOnOff - baseAddress)) {
                 // Boolean value (1 register)
@@ -119,6 +140,10 @@ void GeneratorSetterForm::handleReadCompleted(int startAddress, const QVector<qu
             // Update the UI for this value
             const auto rowIt = m_addressToRow.constFind(currentAddress);
             if (rowIt != m_addressToRow.constEnd()) {
+                if (!result.isChanged(firstIndex, valueIndex - firstIndex)) {
+                    currentAddress += valueIndex - firstIndex;
+                    continue;
+                }
                 const int row = rowIt.value();
                 QTableWidgetItem *valueItem = ui->generatorTableWidget->item(row, 2);
                 if (!valueItem) {
@@ -143,16 +168,11 @@ void GeneratorSetterForm::handleReadCompleted(int startAddress, const QVector<qu
     }
 }
 
-void GeneratorSetterForm::handleWriteCompleted(int startAddress, quint16 numberOfEntries)
+void GeneratorSetterForm::handleWriteCompleted(const ModbusResult &result)
 {
-    Q_UNUSED(numberOfEntries);
-    // Check if this write was for one of our addresses
-    for (const auto &entry : m_entries) {
-        if (entry.address == startAddress) {
-            // Refresh all values after a successful write
-            requestAllValues();
-            break;
-        }
+    // Acknowledged values come back through the subscription, no re-read is needed.
+    if (!result.isOk()) {
+        qWarning() << "Write to" << result.startAddress << "failed:" << result.errorString;
     }
 }
 
@@ -163,12 +183,16 @@ void GeneratorSetterForm::sendState(int address, bool value)
     }
 
     QMetaObject::invokeMethod(m_modbusClient,
-                              [client = m_modbusClient, address, value]() {
-                                  if (!client) {
+                              [client = m_modbusClient, form = QPointer<GeneratorSetterForm>(this), address, value]() {
+                                  if (!client || !form) {
                                       return;
                                   }
-                                  client->writeSingleRegister(address,
-                                                              value ? toLittleEndian(quint16(States::On)) : toLittleEndian(quint16(States::Off)));
+                                  client->writeMultipleRegisters(address,
+                                                                 {value ? toLittleEndian(quint16(States::On)) : toLittleEndian(quint16(States::Off))},
+                                                                 form,
+                                                                 [form](const ModbusResult &result) {
+                                                                     form->handleWriteCompleted(result);
+                                                                 });
                               },
                               Qt::QueuedConnection);
 
@@ -245,7 +269,7 @@ void GeneratorSetterForm::insertRow(const BlockEntry &entry)
     m_addressToRow.insert(entry.address, row);
 }
 
-void GeneratorSetterForm::requestValueByValue() const
+void GeneratorSetterForm::requestValueByValue()
 {
     if (!m_modbusClient) {
         return;
@@ -254,19 +278,21 @@ void GeneratorSetterForm::requestValueByValue() const
     for (const auto &entry : m_entries) {
         const int address = entry.address;
         QMetaObject::invokeMethod(m_modbusClient,
-                                  [client = m_modbusClient, address]() {
-                                      if (!client) {
+                                  [client = m_modbusClient, form = QPointer<GeneratorSetterForm>(this), address]() {
+                                      if (!client || !form) {
                                           return;
                                       }
                                       client->readHoldingRegisters(address,
                                                                    address == GeneratorSetterAddress::TermoStableOnOff ||
-                                                                           address == GeneratorSetterAddress::ImpulseOnOff ? 1 : 2);
+                                                                           address == GeneratorSetterAddress::ImpulseOnOff ? 1 : 2,
+                                                                   form,
+                                                                   {});
                                   },
                                   Qt::QueuedConnection);
     }
 }
 
-void GeneratorSetterForm::requestAllValues() const
+void GeneratorSetterForm::requestAllValues()
 {
     if (!m_modbusClient) {
         return;
@@ -277,15 +303,24 @@ void GeneratorSetterForm::requestAllValues() const
     const int registerCount = GeneratorSetterAddress::AddressTillOfEndGenerator - startAddress; // 0x500-0x505 (6 registers total)
 
     QMetaObject::invokeMethod(m_modbusClient,
-                              [client = m_modbusClient, startAddress, registerCount]() {
-                                  if (!client) {
+                              [client = m_modbusClient, form = QPointer<GeneratorSetterForm>(this), startAddress, registerCount]() {
+                                  if (!client || !form) {
                                       return;
                                   }
-                                  client->readHoldingRegisters(startAddress, registerCount);
+                                  client->readHoldingRegisters(startAddress, registerCount, form, {});
                               },
                               Qt::QueuedConnection);
 }
 
+QVector<PollGroup> GeneratorSetterForm::pollGroups() const
+{
+    return {
+        {GeneratorSetterAddress::TermoStableOnOff,
+         GeneratorSetterAddress::AddressTillOfEndGenerator - GeneratorSetterAddress::TermoStableOnOff,
+         1000},
+    };
+}
+
 void GeneratorSetterForm::on_pushButton_clicked()
 {
     requestAllValues();
@@ -22,8 +22,8 @@ public:
     void setModbusClient(ModbusClient *client);
 
 private slots:
-    void handleReadCompleted(int startAddress, const QVector<quint16> &values);
-    void handleWriteCompleted(int startAddress, quint16 numberOfEntries);
+    void handleReadCompleted(const ModbusResult &result);
+    void handleWriteCompleted(const ModbusResult &result);
     void sendState(int address, bool value);
 
     void on_pushButton_clicked();
@@ -38,8 +38,9 @@ private:
     void setupTable();
     void populateTable();
     void insertRow(const BlockEntry &entry);
-    void requestValueByValue() const;
-    void requestAllValues() const;
+    void requestValueByValue();
+    void requestAllValues() override;
+    QVector<PollGroup> pollGroups() const override;
 
     Ui::GeneratorSetterForm *ui;
     ModbusClient *m_modbusClient = nullptr;
@@ -42,21 +42,45 @@ void LimitAndTargetValuesForm::setModbusClient(ModbusClient *client)
     }
 
     if (m_modbusClient) {
-        disconnect(m_modbusClient, &ModbusClient::readCompleted,
-                   this, &LimitAndTargetValuesForm::handleReadCompleted);
+        QMetaObject::invokeMethod(m_modbusClient,
+                                  [oldClient = m_modbusClient, form = static_cast<QObject *>(this)]() {
+                                      oldClient->unsubscribe(form);
+                                  },
+                                  Qt::QueuedConnection);
     }
-
     m_modbusClient = client;
-
-    if (m_modbusClient) {
-        connect(m_modbusClient, &ModbusClient::readCompleted,
-                this, &LimitAndTargetValuesForm::handleReadCompleted);
-        // requestAllValues();
+    if (!m_modbusClient) {
+        return;
     }
+
+    // Every read covering the form's registers is routed here, whoever requested it.
+    QMetaObject::invokeMethod(m_modbusClient,
+                              [client = m_modbusClient, form = QPointer<LimitAndTargetValuesForm>(this)]() {
+                                  if (!client || !form) {
+                                      return;
+                                  }
+                                  const auto onRead = [form](const ModbusResult &result) {
+                                      form->handleReadCompleted(result);
+                                  };
+                                  client->subscribe(ValuesTableAddress::CaseTemperatureMinValue_1,
+                                                    ValuesTableAddress::AddressTillOfEndValues - ValuesTableAddress::CaseTemperatureMinValue_1,
+                                                    form,
+                                                    onRead,
+                                                    1,
+                                                    SubscriptionRouter::ChangesOnly);
+                              },
+                              Qt::QueuedConnection);
 }
 
-void LimitAndTargetValuesForm::handleReadCompleted(int startAddress, const QVector<quint16> &values)
+void LimitAndTargetValuesForm::handleReadCompleted(const ModbusResult &result)
 {
+    if (!result.isOk()) {
+        return;
+    }
+
+    const int startAddress = result.startAddress;
+    const RegisterSlice &values = result.values;
+
     // quint32 val32 = (quint32(toBigEndian(values.last())) << 16) | toBigEndian(values.first());
     // quint32 val32 = (quint32((values.first())) << 16) | (values.last());
     if (m_addressToRow.constFind(startAddress) != m_addressToRow.constEnd())
@@ -76,10 +100,15 @@ void LimitAndTargetValuesForm::handleReadCompleted(int startAddress, const QVect
                             qFromLittleEndian<quint16>(values.data() + valueIndex);
             float fValue = 0.f;
             std::memcpy(&fValue, &val32, sizeof(fValue));
+            const bool changed = result.isChanged(valueIndex, 2);
             valueIndex += 2;
 
             const auto rowIt = m_addressToRow.constFind(currentAddress);
             if (rowIt != m_addressToRow.constEnd()) {
+                if (!changed) {
+                    currentAddress += 2;
+                    continue;
+                }
                 const int row = rowIt.value();
                 QTableWidgetItem *valueItem = ui->limitAndTargetTableWidget->item(row, 2);
                 if (!valueItem) {
@@ -169,7 +198,7 @@ void LimitAndTargetValuesForm::insertRow(const BlockEntry &entry)
     m_addressToRow.insert(entry.address, row);
 }
 
-void LimitAndTargetValuesForm::requestValueByValue() const
+void LimitAndTargetValuesForm::requestValueByValue()
 {
     if (!m_modbusClient) {
         return;
@@ -178,17 +207,17 @@ void LimitAndTargetValuesForm::requestValueByValue() const
     for (const auto &entry : m_entries) {
         const int address = entry.address;
         QMetaObject::invokeMethod(m_modbusClient,
-                                  [client = m_modbusClient, address]() {
-                                      if (!client) {
+                                  [client = m_modbusClient, form = QPointer<LimitAndTargetValuesForm>(this), address]() {
+                                      if (!client || !form) {
                                           return;
                                       }
-                                      client->readHoldingRegisters(address, 2);
+                                      client->readHoldingRegisters(address, 2, form, {});
                                   },
                                   Qt::QueuedConnection);
     }
 }
 
-void LimitAndTargetValuesForm::requestAllValues() const
+void LimitAndTargetValuesForm::requestAllValues()
 {
     if (!m_modbusClient) {
         return;
@@ -200,15 +229,26 @@ void LimitAndTargetValuesForm::requestAllValues() const
         ValuesTableAddress::AddressTillOfEndValues - startAddress; // 0x200-0x240
 
     QMetaObject::invokeMethod(m_modbusClient,
-                              [client = m_modbusClient, startAddress, registerCount]() {
-                                  if (!client) {
+                              [client = m_modbusClient, form = QPointer<LimitAndTargetValuesForm>(this), startAddress, registerCount]() {
+                                  if (!client || !form) {
                                       return;
                                   }
-                                  client->readHoldingRegisters(startAddress, registerCount);
+                                  client->readHoldingRegisters(startAddress, registerCount, form, {});
                               },
                               Qt::QueuedConnection);
 }
 
+QVector<PollGroup> LimitAndTargetValuesForm::pollGroups() const
+{
+    // Limits and targets are settings that can be changed outside this application; they
+    // change rarely, so they are polled slower than the measurements.
+    return {
+        {ValuesTableAddress::CaseTemperatureMinValue_1,
+         ValuesTableAddress::AddressTillOfEndValues - ValuesTableAddress::CaseTemperatureMinValue_1,
+         5000},
+    };
+}
+
 void LimitAndTargetValuesForm::on_pushButton_clicked()
 {
     requestAllValues();
@@ -20,7 +20,7 @@ public:
     void setModbusClient(ModbusClient *client);
 
 private slots:
-    void handleReadCompleted(int startAddress, const QVector<quint16> &values);
+    void handleReadCompleted(const ModbusResult &result);
 
     void on_pushButton_clicked();
 
@@ -34,8 +34,9 @@ private:
     void setupTable();
     void populateTable();
     void insertRow(const BlockEntry &entry);
-    void requestValueByValue() const;
-    void requestAllValues() const;
+    void requestValueByValue();
+    void requestAllValues() override;
+    QVector<PollGroup> pollGroups() const override;
 
     Ui::LimitAndTargetValuesForm *ui;
     ModbusClient *m_modbusClient = nullptr;
@@ -1,5 +1,6 @@
 #include "dockmanager.h"
 #include "controller.h"
+#include "snapshotassembler.h"
 
 #include <QApplication>
 #include <QCoreApplication>
@@ -9,12 +10,15 @@ int main(int argc, char *argv[])
     QApplication a(argc, argv);
     QCoreApplication::setApplicationName("Laser Backlight Tester");
     qRegisterMetaType<QVector<quint16>>("QVector<quint16>");
+    qRegisterMetaType<PollFramePtr>("PollFramePtr");
     Controller c;
     DockManager w;
     QObject::connect(&w, &DockManager::modeRequested, &c, &Controller::sendMessageForMode);
     QObject::connect(&w, &DockManager::connectToTcpPort, &c, &Controller::connectToTcpPort);
     QObject::connect(&w, &DockManager::disconnectFromTcp, &c, &Controller::disconnectFromTcp);
     w.setModbusClient(c.modbusClient());
+    w.setPollScheduler(c.pollScheduler());
+    w.setCaptureRecorder(c.captureRecorder());
     w.show();
     return a.exec();
 }
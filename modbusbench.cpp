@@ -0,0 +1,468 @@
+#include "modbusclient.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QSharedPointer>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QThread>
+#include <QTimer>
+#include <QtEndian>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <new>
+
+namespace {
+// Heap allocations made by this thread while counting is on. The simulator runs in
+// its own thread, so only the client side is counted.
+thread_local bool t_countAllocations = false;
+thread_local quint64 t_allocations = 0;
+}
+
+void *operator new(std::size_t size)
+{
+    if (t_countAllocations) {
+        ++t_allocations;
+    }
+    if (void *memory = std::malloc(size ? size : 1)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void *memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
+namespace {
+constexpr int kDefaultRequests = 20000;
+constexpr int kPipelineDepth = 5;
+constexpr quint16 kReadRegisters = 10;
+// Far enough apart that the read planner never merges two outstanding reads.
+constexpr int kReadAddressStride = 200;
+constexpr int kConnectTimeoutMs = 5000;
+constexpr int kAllocationCycles = 200;
+constexpr int kWriteSamples = 2000;
+constexpr int kWriteAddress = 0x500;
+// The windows Controller runs the application with.
+constexpr int kDispatchBatchingWindowUs = 1000;
+constexpr int kWriteCombiningWindowUs = 2000;
+
+// Ranges one poll cycle of the application reads, after the scheduler has merged its
+// groups: sync pulses, mode, sensors, block statuses, limits and generator.
+struct CycleRead
+{
+    int startAddress;
+    quint16 numberOfEntries;
+};
+constexpr CycleRead kPollCycle[] = {
+    {0x010, 5},
+    {0x100, 2},
+    {0x102, 0x16},
+    {0x118, 6},
+    {0x11e, 0x0e},
+    {0x12c, 2},
+    {0x200, 0x40},
+    {0x500, 6},
+};
+
+constexpr quint8 kReadHoldingRegisters = 0x03;
+constexpr quint8 kWriteSingleRegister = 0x06;
+constexpr quint8 kWriteMultipleRegisters = 0x10;
+constexpr quint8 kReadWriteMultipleRegisters = 0x17;
+constexpr int kMbapHeaderSize = 7;
+
+void putUint16(QByteArray &buffer, quint16 value)
+{
+    buffer.append(char(value >> 8));
+    buffer.append(char(value & 0xFF));
+}
+
+quint16 getUint16(const uchar *src)
+{
+    return qFromBigEndian<quint16>(src);
+}
+
+qint64 percentileUs(QVector<qint64> samples, double percentile)
+{
+    if (samples.isEmpty()) {
+        return 0;
+    }
+    std::sort(samples.begin(), samples.end());
+    const int index = qBound(0, int(percentile / 100.0 * samples.size() + 0.5) - 1, int(samples.size()) - 1);
+    return samples.at(index);
+}
+
+const char *engineName(ModbusClient::Engine engine)
+{
+    return engine == ModbusClient::Engine::Native ? "native" : "qtserialbus";
+}
+}
+
+/**
+ * @brief Modbus TCP server answering FC03, FC06, FC16 and FC23 from an in-memory register
+ * bank, run in its own thread so it does not share the client's event loop.
+ */
+class ModbusSimulator : public QObject
+{
+    Q_OBJECT
+
+public:
+    using QObject::QObject;
+
+    // Starts listening on a free local port and returns it. Call in the simulator thread.
+    quint16 listen()
+    {
+        m_server = new QTcpServer(this);
+        connect(m_server, &QTcpServer::newConnection, this, [this]() {
+            while (QTcpSocket *socket = m_server->nextPendingConnection()) {
+                serve(socket);
+            }
+        });
+        m_server->listen(QHostAddress::LocalHost, 0);
+        return m_server->serverPort();
+    }
+
+signals:
+    // A write request reached the socket, at ModbusResult::monotonicUs() time receivedUs.
+    void writeReceived(int address, qint64 receivedUs);
+
+private:
+    void serve(QTcpSocket *socket)
+    {
+        socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+        connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+        const auto buffer = QSharedPointer<QByteArray>::create();
+        connect(socket, &QTcpSocket::readyRead, this, [this, socket, buffer]() {
+            const qint64 receivedUs = ModbusResult::monotonicUs();
+            buffer->append(socket->readAll());
+            while (buffer->size() >= kMbapHeaderSize) {
+                const auto *frame = reinterpret_cast<const uchar *>(buffer->constData());
+                const int frameSize = 6 + getUint16(frame + 4);
+                if (buffer->size() < frameSize) {
+                    break;
+                }
+                socket->write(respond(frame, frameSize, receivedUs));
+                buffer->remove(0, frameSize);
+            }
+        });
+    }
+
+    QByteArray respond(const uchar *frame, int frameSize, qint64 receivedUs)
+    {
+        const uchar *pdu = frame + kMbapHeaderSize;
+        const quint8 function = pdu[0];
+        QByteArray response;
+        response.append(char(function));
+
+        if (function == kReadHoldingRegisters && frameSize >= kMbapHeaderSize + 5) {
+            readRegisters(response, getUint16(pdu + 1), getUint16(pdu + 3));
+        } else if (function == kWriteSingleRegister && frameSize >= kMbapHeaderSize + 5) {
+            const quint16 address = getUint16(pdu + 1);
+            m_registers[address] = getUint16(pdu + 3);
+            emit writeReceived(address, receivedUs);
+            response.append(reinterpret_cast<const char *>(pdu + 1), 4);
+        } else if (function == kWriteMultipleRegisters && frameSize >= kMbapHeaderSize + 6) {
+            const quint16 address = getUint16(pdu + 1);
+            const quint16 count = getUint16(pdu + 3);
+            writeRegisters(address, count, pdu + 6);
+            emit writeReceived(address, receivedUs);
+            putUint16(response, address);
+            putUint16(response, count);
+        } else if (function == kReadWriteMultipleRegisters && frameSize >= kMbapHeaderSize + 10) {
+            const quint16 writeAddress = getUint16(pdu + 5);
+            writeRegisters(writeAddress, getUint16(pdu + 7), pdu + 10);
+            emit writeReceived(writeAddress, receivedUs);
+            readRegisters(response, getUint16(pdu + 1), getUint16(pdu + 3));
+        } else {
+            // Illegal function.
+            response[0] = char(function | 0x80);
+            response.append(char(0x01));
+        }
+
+        QByteArray adu;
+        adu.reserve(kMbapHeaderSize + response.size());
+        adu.append(reinterpret_cast<const char *>(frame), 4);
+        putUint16(adu, quint16(response.size() + 1));
+        adu.append(char(frame[6]));
+        adu.append(response);
+        return adu;
+    }
+
+    void readRegisters(QByteArray &response, quint16 address, quint16 count)
+    {
+        response.append(char(count * 2));
+        for (int i = 0; i < count; ++i) {
+            putUint16(response, m_registers.at((address + i) & 0xFFFF));
+        }
+    }
+
+    void writeRegisters(quint16 address, quint16 count, const uchar *values)
+    {
+        for (int i = 0; i < count; ++i) {
+            m_registers[(address + i) & 0xFFFF] = getUint16(values + 2 * i);
+        }
+    }
+
+    QTcpServer *m_server = nullptr;
+    QVector<quint16> m_registers = QVector<quint16>(0x10000);
+};
+
+namespace {
+bool connectClient(ModbusClient &client, quint16 port)
+{
+    QEventLoop loop;
+    QObject::connect(&client, &ModbusClient::connectionStateChanged, &loop, [&loop](bool connected) {
+        if (connected) {
+            loop.quit();
+        }
+    });
+    QTimer::singleShot(kConnectTimeoutMs, &loop, &QEventLoop::quit);
+    client.connectDevice(QStringLiteral("127.0.0.1"), port);
+    if (!client.isConnected()) {
+        loop.exec();
+    }
+    return client.isConnected();
+}
+
+// Closed loop of reads keeping kPipelineDepth requests outstanding, each timed from
+// the call to its callback.
+void benchReads(ModbusClient::Engine engine, quint16 port, int requests)
+{
+    ModbusClient client;
+    client.setEngine(engine);
+    client.setMaxInFlightRequests(kPipelineDepth);
+    client.setReadGapFillThreshold(0);
+    if (!connectClient(client, port)) {
+        std::printf("%-12s connection failed\n", engineName(engine));
+        return;
+    }
+
+    QVector<qint64> latenciesUs;
+    latenciesUs.reserve(requests);
+    int issued = 0;
+    int failed = 0;
+    QEventLoop loop;
+    QElapsedTimer clock;
+    std::function<void()> issue = [&]() {
+        const int address = (issued++ % 100) * kReadAddressStride;
+        const qint64 startNs = clock.nsecsElapsed();
+        client.readHoldingRegisters(
+            address,
+            kReadRegisters,
+            &loop,
+            [&, startNs](const ModbusResult &result) {
+                latenciesUs.append((clock.nsecsElapsed() - startNs) / 1000);
+                if (!result.isOk()) {
+                    ++failed;
+                }
+                if (latenciesUs.size() == requests) {
+                    loop.quit();
+                } else if (issued < requests) {
+                    issue();
+                }
+            },
+            1,
+            ModbusClient::ReadSource::Device);
+    };
+
+    clock.start();
+    for (int i = 0; i < kPipelineDepth && issued < requests; ++i) {
+        issue();
+    }
+    loop.exec();
+    const double elapsedS = clock.nsecsElapsed() / 1e9;
+
+    std::printf("%-12s %10.0f req/s   p50 %6lld us   p99 %6lld us   failed %d\n",
+                engineName(engine),
+                requests / elapsedS,
+                static_cast<long long>(percentileUs(latenciesUs, 50)),
+                static_cast<long long>(percentileUs(latenciesUs, 99)),
+                failed);
+}
+}
+
+namespace {
+// Allocations made by the client thread for one poll cycle, from issuing its reads to
+// the last callback, with a subscriber per form range. copyingListener also connects
+// readCompleted, which hands every requested part out as a detached QVector.
+void benchPollCycleAllocations(quint16 port, bool copyingListener)
+{
+    ModbusClient client;
+    client.setEngine(ModbusClient::Engine::Native);
+    client.setMaxInFlightRequests(kPipelineDepth);
+    if (!connectClient(client, port)) {
+        std::printf("allocations: connection failed\n");
+        return;
+    }
+
+    QObject subscriber;
+    quint64 checksum = 0;
+    const auto consume = [&checksum](const ModbusResult &result) {
+        for (const quint16 value : result.values) {
+            checksum += value;
+        }
+    };
+    client.subscribe(0x010, 5, &subscriber, consume);
+    client.subscribe(0x100, 0x2e, &subscriber, consume);
+    client.subscribe(0x200, 0x40, &subscriber, consume);
+    client.subscribe(0x500, 6, &subscriber, consume);
+    if (copyingListener) {
+        QObject::connect(&client, &ModbusClient::readCompleted, &subscriber,
+                         [&checksum](int, const QVector<quint16> &values) {
+                             checksum += quint64(values.size());
+                         });
+    }
+
+    QEventLoop loop;
+    const auto runCycle = [&]() {
+        int outstanding = int(std::size(kPollCycle));
+        for (const CycleRead &read : kPollCycle) {
+            client.readHoldingRegisters(
+                read.startAddress,
+                read.numberOfEntries,
+                &loop,
+                [&](const ModbusResult &result) {
+                    consume(result);
+                    if (--outstanding == 0) {
+                        // Let the subscriber deliveries queued with the last reply run too.
+                        QTimer::singleShot(0, &loop, &QEventLoop::quit);
+                    }
+                },
+                1,
+                ModbusClient::ReadSource::Device);
+        }
+        loop.exec();
+    };
+
+    // The first cycle fills the register image and the transport buffers.
+    runCycle();
+    t_allocations = 0;
+    for (int i = 0; i < kAllocationCycles; ++i) {
+        t_countAllocations = true;
+        runCycle();
+        t_countAllocations = false;
+    }
+
+    std::printf("%-34s %8.1f allocations/cycle   (checksum %llu)\n",
+                copyingListener ? "slices + readCompleted copies" : "slices only",
+                double(t_allocations) / kAllocationCycles,
+                static_cast<unsigned long long>(checksum));
+}
+}
+
+namespace {
+// One operator write at a time, timed from writeSingleRegister to the simulator
+// reading its bytes off the socket. The next write goes out once both the reply and
+// the simulator's report are in, so writes never queue behind each other.
+void benchWriteToWire(ModbusClient::Engine engine, quint16 port, ModbusSimulator *simulator, bool windows)
+{
+    ModbusClient client;
+    client.setEngine(engine);
+    client.setMaxInFlightRequests(kPipelineDepth);
+    client.setDispatchBatchingWindowUs(windows ? kDispatchBatchingWindowUs : 0);
+    client.setWriteCombiningWindowUs(windows ? kWriteCombiningWindowUs : 0);
+    if (!connectClient(client, port)) {
+        std::printf("%-12s connection failed\n", engineName(engine));
+        return;
+    }
+
+    QVector<qint64> latenciesUs;
+    latenciesUs.reserve(kWriteSamples);
+    qint64 sentUs = 0;
+    bool replied = false;
+    bool received = false;
+    QEventLoop loop;
+    const auto issue = [&]() {
+        replied = false;
+        received = false;
+        sentUs = ModbusResult::monotonicUs();
+        client.writeSingleRegister(kWriteAddress, quint16(latenciesUs.size()));
+    };
+    const auto settle = [&]() {
+        if (!replied || !received) {
+            return;
+        }
+        if (latenciesUs.size() == kWriteSamples) {
+            loop.quit();
+        } else {
+            issue();
+        }
+    };
+    QObject::connect(simulator, &ModbusSimulator::writeReceived, &loop, [&](int address, qint64 receivedUs) {
+        if (address == kWriteAddress && !received) {
+            received = true;
+            latenciesUs.append(receivedUs - sentUs);
+            settle();
+        }
+    });
+    QObject::connect(&client, &ModbusClient::writeCompleted, &loop, [&](int startAddress, quint16) {
+        if (startAddress == kWriteAddress) {
+            replied = true;
+            settle();
+        }
+    });
+
+    issue();
+    loop.exec();
+
+    std::printf("%-12s %-8s p50 %6lld us   p99 %6lld us\n",
+                engineName(engine),
+                windows ? "windows" : "none",
+                static_cast<long long>(percentileUs(latenciesUs, 50)),
+                static_cast<long long>(percentileUs(latenciesUs, 99)));
+}
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    const int requests = argc > 1 ? qMax(1, QByteArray(argv[1]).toInt()) : kDefaultRequests;
+
+    QThread simulatorThread;
+    auto *simulator = new ModbusSimulator;
+    simulator->moveToThread(&simulatorThread);
+    QObject::connect(&simulatorThread, &QThread::finished, simulator, &QObject::deleteLater);
+    simulatorThread.start();
+    quint16 port = 0;
+    QMetaObject::invokeMethod(
+        simulator,
+        [simulator, &port]() {
+            port = simulator->listen();
+        },
+        Qt::BlockingQueuedConnection);
+
+    std::printf("Reads of %u registers, %d in flight, %d requests\n", unsigned(kReadRegisters), kPipelineDepth, requests);
+    for (const auto engine : {ModbusClient::Engine::QtSerialBus, ModbusClient::Engine::Native}) {
+        benchReads(engine, port, requests);
+    }
+
+    std::printf("\nOne poll cycle of %d reads, native engine, %d cycles\n", int(std::size(kPollCycle)), kAllocationCycles);
+    benchPollCycleAllocations(port, false);
+    benchPollCycleAllocations(port, true);
+
+    std::printf("\nwriteSingleRegister to simulator socket, %d writes, batching %d us and combining %d us windows on or off\n",
+                kWriteSamples,
+                kDispatchBatchingWindowUs,
+                kWriteCombiningWindowUs);
+    for (const auto engine : {ModbusClient::Engine::QtSerialBus, ModbusClient::Engine::Native}) {
+        benchWriteToWire(engine, port, simulator, false);
+        benchWriteToWire(engine, port, simulator, true);
+    }
+
+    simulatorThread.quit();
+    simulatorThread.wait();
+    return 0;
+}
+
+#include "modbusbench.moc"
@@ -1,60 +1,71 @@
 #include "modbusclient.h"
+#include "modbusreadplanner.h"
+#include "qtmodbustransport.h"
+#include "rawmodbustransport.h"
 
-#include <QtSerialBus/QModbusDataUnit>
-#include <QtSerialBus/QModbusReply>
-#include <QtSerialBus/QModbusDevice>
-#include <QtSerialBus/QModbusTcpClient>
 #include <QLoggingCategory>
+#include <QMetaMethod>
+#include <QRandomGenerator>
 #include <QVariant>
 
 #include <QtGlobal>
 
+#include <algorithm>
+#include <utility>
+
 #include <QTimer>
 
 namespace {
 QLoggingCategory lcModbusClient("modbus.client");
+
+// The register image mirrors the laser controller only.
+constexpr int kImageServerAddress = 1;
+
+// FC16 and FC23 limits on registers written per request.
+constexpr int kMaxWriteRegisters = 123;
+constexpr int kMaxReadWriteWriteRegisters = 121;
+
+// Exception code of a device that does not implement the function.
+constexpr quint8 kIllegalFunction = 0x01;
 }
 
 ModbusClient::ModbusClient(QObject *parent)
     : QObject(parent)
-    , m_client(new QModbusTcpClient(this))
     , m_dispatchTimer(new QTimer(this))
     , m_replyTimeout(new QTimer(this))
     , m_connectTimeoutTimer(new QTimer(this))
+    , m_heartbeatTimer(new QTimer(this))
 {
     m_connectTimeoutTimer->setSingleShot(true);
     connect(m_connectTimeoutTimer, &QTimer::timeout, this, [this]() {
-        if (!m_client) {
-            return;
-        }
-        if (m_client->state() != QModbusDevice::ConnectingState) {
+        if (!m_transport || m_transport->state() != ModbusTransport::Connecting) {
             return;
         }
 
         handleError(tr("Connect timeout to %1:%2").arg(m_host).arg(m_port));
-        recreateClient();
-        if (!m_host.isEmpty()) {
-            m_client->connectDevice();
-        }
+        m_transport->abort();
+        // The attempt failed; ConnectionManager decides when to try again.
+        emit connectionStateChanged(false);
     });
 
-    recreateClient();
+    createTransport();
 
-    m_dispatchTimer->setInterval(100);
-    m_dispatchTimer->setSingleShot(false);
+    m_dispatchTimer->setSingleShot(true);
+    m_dispatchTimer->setTimerType(Qt::PreciseTimer);
     connect(m_dispatchTimer, &QTimer::timeout, this, [this]() {
         dispatchQueuedMessages();
     });
 
+    m_clock.start();
+
     m_replyTimeout->setSingleShot(true);
+    m_replyTimeout->setTimerType(Qt::PreciseTimer);
     connect(m_replyTimeout, &QTimer::timeout, this, [this]() {
-        if (!m_activeReply) {
-            return;
-        }
-        handleError(tr("Modbus request timeout"), m_activeReply);
-        m_activeReply->deleteLater();
-        m_activeReply.clear();
-        onReplySettled();
+        handleReplyTimeouts();
+    });
+
+    connect(m_heartbeatTimer, &QTimer::timeout, this, [this]() {
+        sendHeartbeat();
     });
 }
 
@@ -65,47 +76,153 @@ void ModbusClient::setConnectTimeoutMs(int timeoutMs)
     m_connectTimeoutMs = timeoutMs;
 }
 
-void ModbusClient::recreateClient()
+void ModbusClient::setMaxInFlightRequests(int count)
+{
+    m_maxInFlight = qMax(1, count);
+}
+
+int ModbusClient::maxInFlightRequests() const
+{
+    return m_maxInFlight;
+}
+
+void ModbusClient::setDispatchBatchingWindowUs(int windowUs)
+{
+    m_batchingWindowUs = qMax(0, windowUs);
+}
+
+int ModbusClient::dispatchBatchingWindowUs() const
+{
+    return m_batchingWindowUs;
+}
+
+void ModbusClient::setWriteCombiningWindowUs(int windowUs)
+{
+    m_writeCombiningWindowUs = qMax(0, windowUs);
+}
+
+int ModbusClient::writeCombiningWindowUs() const
+{
+    return m_writeCombiningWindowUs;
+}
+
+void ModbusClient::setReadWriteFusion(bool enabled)
+{
+    m_readWriteFusion = enabled;
+}
+
+bool ModbusClient::readWriteFusion() const
+{
+    return m_readWriteFusion;
+}
+
+void ModbusClient::setMaxQueuedReads(int count)
+{
+    m_maxQueuedReads = qMax(0, count);
+}
+
+int ModbusClient::maxQueuedReads() const
+{
+    return m_maxQueuedReads;
+}
+
+void ModbusClient::setReadGapFillThreshold(int registers)
+{
+    m_gapFillThreshold = qMax(0, registers);
+}
+
+int ModbusClient::readGapFillThreshold() const
+{
+    return m_gapFillThreshold;
+}
+
+const RegisterImage &ModbusClient::registerImage() const
+{
+    return m_registerImage;
+}
+
+void ModbusClient::setCacheMaxAgeMs(int maxAgeMs)
+{
+    m_cacheMaxAgeMs = qMax(0, maxAgeMs);
+}
+
+int ModbusClient::cacheMaxAgeMs() const
+{
+    return m_cacheMaxAgeMs;
+}
+
+void ModbusClient::setEngine(Engine engine)
 {
-    if (m_client) {
-        disconnect(m_client, nullptr, this, nullptr);
-        m_client->deleteLater();
+    if (engine == m_engine) {
+        return;
     }
 
-    m_client = new QModbusTcpClient(this);
+    const bool reconnect = m_transport && m_transport->state() != ModbusTransport::Unconnected;
+    m_engine = engine;
+    abortInFlight(tr("Modbus operation aborted: transport engine changed."));
+    createTransport();
+    if (reconnect) {
+        emit connectionStateChanged(false);
+        connectDevice(m_host, m_port);
+    }
+}
+
+ModbusClient::Engine ModbusClient::engine() const
+{
+    return m_engine;
+}
+
+void ModbusClient::createTransport()
+{
+    if (m_transport) {
+        disconnect(m_transport, nullptr, this, nullptr);
+        m_transport->abort();
+        m_transport->deleteLater();
+    }
 
-    m_client->setConnectionParameter(QModbusDevice::NetworkAddressParameter, m_host);
-    m_client->setConnectionParameter(QModbusDevice::NetworkPortParameter, m_port);
-    m_client->setTimeout(m_timeoutMs);
-    m_client->setNumberOfRetries(0);
+    if (m_engine == Engine::Native) {
+        m_transport = new RawModbusTransport(this);
+    } else {
+        m_transport = new QtModbusTransport(this);
+    }
+    // The transport's own timeout only backs up the adaptive one.
+    m_transport->setConnectionParameters(m_host, m_port, qMax(m_timeoutMs, m_maxReplyTimeoutMs));
 
-    connect(m_client, &QModbusTcpClient::stateChanged, this, [this](QModbusDevice::State state) {
-        if (state == QModbusDevice::ConnectedState) {
+    connect(m_transport, &ModbusTransport::stateChanged, this, [this](ModbusTransport::State state) {
+        if (state == ModbusTransport::Connected) {
             if (m_connectTimeoutTimer) {
                 m_connectTimeoutTimer->stop();
             }
+            resetRoundTripEstimate();
+            m_connectedAtMs = m_clock.elapsed();
+            m_awaitingFirstData = true;
+            m_heartbeatMisses = 0;
+            m_lastReplyMs = m_clock.elapsed();
+            if (m_heartbeatTimer->interval() > 0) {
+                m_heartbeatTimer->start();
+            }
             emit connectionStateChanged(true);
-            startDispatchTimerIfNeeded();
-        } else if (state == QModbusDevice::ConnectingState) {
+            scheduleDispatch();
+        } else if (state == ModbusTransport::Connecting) {
             if (m_connectTimeoutTimer) {
                 const int t = m_connectTimeoutMs > 0 ? m_connectTimeoutMs : 2000;
                 m_connectTimeoutTimer->start(t);
             }
-        } else if (state == QModbusDevice::UnconnectedState) {
+        } else if (state == ModbusTransport::Unconnected) {
             if (m_connectTimeoutTimer) {
                 m_connectTimeoutTimer->stop();
             }
             stopDispatching();
+            m_heartbeatTimer->stop();
+            m_awaitingFirstData = false;
+            abortInFlight(tr("Modbus operation aborted: connection was closed during request."));
+            abortQueuedReads(tr("Modbus read aborted: connection was closed."));
             emit connectionStateChanged(false);
         }
     });
 
-    connect(m_client, &QModbusTcpClient::errorOccurred, this, [this](QModbusDevice::Error error) {
-        if (error == QModbusDevice::NoError) {
-            return;
-        }
-        emit errorOccurred(tr("Modbus client error: %1").arg(m_client->errorString()));
-    });
+    connect(m_transport, &ModbusTransport::errorOccurred, this, &ModbusClient::errorOccurred);
+    connect(m_transport, &ModbusTransport::finished, this, &ModbusClient::handleTransportFinished);
 }
 
 void ModbusClient::setConnectionParameters(const QString &host, quint16 port, int timeoutMs)
@@ -114,20 +231,199 @@ void ModbusClient::setConnectionParameters(const QString &host, quint16 port, in
     m_port = port;
     m_timeoutMs = timeoutMs;
 
-    if (!m_client) {
+    if (m_transport) {
+        m_transport->setConnectionParameters(m_host, m_port, qMax(m_timeoutMs, m_maxReplyTimeoutMs));
+    }
+}
+
+void ModbusClient::setReplyTimeoutBounds(int minMs, int maxMs)
+{
+    m_minReplyTimeoutMs = qMax(1, minMs);
+    m_maxReplyTimeoutMs = qMax(m_minReplyTimeoutMs, maxMs);
+    m_replyTimeoutMs = qBound(m_minReplyTimeoutMs, m_replyTimeoutMs, m_maxReplyTimeoutMs);
+}
+
+int ModbusClient::replyTimeoutMs() const
+{
+    return m_replyTimeoutMs;
+}
+
+int ModbusClient::roundTripTimeUs() const
+{
+    return int(m_smoothedRttUs);
+}
+
+void ModbusClient::setReadRetryPolicy(int maxRetries, int baseBackoffMs, int cycleDeadlineMs)
+{
+    m_maxRetries = qMax(0, maxRetries);
+    m_retryBackoffMs = qMax(0, baseBackoffMs);
+    m_retryCycleDeadlineMs = qMax(0, cycleDeadlineMs);
+}
+
+void ModbusClient::setRetryWrites(bool enabled)
+{
+    m_retryWrites = enabled;
+}
+
+void ModbusClient::setHeartbeat(int intervalMs, int maxMisses, int address)
+{
+    m_heartbeatAddress = address;
+    m_maxHeartbeatMisses = qMax(1, maxMisses);
+    m_heartbeatTimer->setInterval(qMax(0, intervalMs));
+    if (intervalMs > 0 && isConnected()) {
+        m_heartbeatTimer->start();
+    } else if (intervalMs <= 0) {
+        m_heartbeatTimer->stop();
+    }
+}
+
+void ModbusClient::sendHeartbeat()
+{
+    // Only an idle link needs probing, any answered request proves the peer is alive.
+    if (!isConnected() || !m_inFlight.isEmpty()
+        || m_clock.elapsed() - m_lastReplyMs < m_heartbeatTimer->interval()) {
         return;
     }
 
-    m_client->setConnectionParameter(QModbusDevice::NetworkAddressParameter, m_host);
-    m_client->setConnectionParameter(QModbusDevice::NetworkPortParameter, m_port);
-    m_client->setTimeout(m_timeoutMs);
+    Transaction transaction;
+    transaction.isRead = true;
+    transaction.isHeartbeat = true;
+    transaction.startAddress = m_heartbeatAddress;
+    transaction.numberOfEntries = 1;
+    transaction.enqueuedNs = m_clock.nsecsElapsed();
+    if (sendTransaction(transaction)) {
+        rearmReplyTimeout();
+    }
+}
+
+void ModbusClient::registerMiss()
+{
+    if (m_heartbeatTimer->interval() <= 0 || ++m_heartbeatMisses < m_maxHeartbeatMisses) {
+        return;
+    }
+
+    handleError(tr("No answer from %1:%2 %3 times in a row, dropping the connection")
+                    .arg(m_host)
+                    .arg(m_port)
+                    .arg(m_heartbeatMisses));
+    m_heartbeatMisses = 0;
+    m_transport->abort();
+}
+
+void ModbusClient::setWriteExpiryMs(int expiryMs)
+{
+    m_writeExpiryMs = qMax(0, expiryMs);
+}
+
+int ModbusClient::timeToFirstDataMs() const
+{
+    return m_timeToFirstDataMs.loadRelaxed();
+}
+
+const ModbusMetrics &ModbusClient::metrics() const
+{
+    return m_metrics;
+}
+
+ModbusMetrics::Snapshot ModbusClient::metricsSnapshot() const
+{
+    return m_metrics.snapshot();
+}
+
+void ModbusClient::recordOutcome(const InFlightTransaction &inFlight, const ModbusResult &result)
+{
+    switch (result.status) {
+    case ModbusResult::Ok:
+    case ModbusResult::ProtocolError: {
+        const qint64 nowNs = m_clock.nsecsElapsed();
+        m_metrics.recordLatency(inFlight.transaction.isReadWrite ? ModbusMetrics::ReadWriteRegisters
+                                : inFlight.transaction.isRead ? ModbusMetrics::ReadHoldingRegisters
+                                                              : ModbusMetrics::WriteMultipleRegisters,
+                                inFlight.transaction.startAddress,
+                                (inFlight.sentNs - inFlight.transaction.enqueuedNs) / 1000,
+                                (nowNs - inFlight.sentNs) / 1000);
+        m_metrics.increment(ModbusMetrics::Answered);
+        if (result.status == ModbusResult::ProtocolError) {
+            m_metrics.increment(ModbusMetrics::ProtocolExceptions);
+        }
+        break;
+    }
+    case ModbusResult::Timeout:
+        m_metrics.increment(ModbusMetrics::Timeouts);
+        break;
+    case ModbusResult::Aborted:
+        m_metrics.increment(ModbusMetrics::Aborted);
+        break;
+    case ModbusResult::Error:
+        m_metrics.increment(ModbusMetrics::Errors);
+        break;
+    }
+}
+
+void ModbusClient::updateQueueGauges()
+{
+    m_metrics.setGauge(ModbusMetrics::WriteQueueDepth, int(m_writeQueue.size()));
+    m_metrics.setGauge(ModbusMetrics::ReadQueueDepth, int(m_readQueue.size() + m_plannedReads.size() + m_captureReads.size()));
+    m_metrics.setGauge(ModbusMetrics::InFlight, int(m_inFlight.size()));
+}
+
+void ModbusClient::dropOldestQueuedRead()
+{
+    // Planned reads were queued first, so the oldest unsent read is at their front.
+    const Transaction dropped = m_plannedReads.isEmpty() ? m_readQueue.takeFirst() : m_plannedReads.takeFirst();
+    qCDebug(lcModbusClient) << "Read queue full, dropping read at" << dropped.startAddress;
+
+    ModbusResult result;
+    result.status = ModbusResult::Aborted;
+    result.errorString = tr("Modbus read at 0x%1 dropped: too many queued reads")
+                             .arg(dropped.startAddress, 0, 16);
+    completeTransaction(dropped, result);
+    m_metrics.increment(ModbusMetrics::DroppedPolls);
+}
+
+void ModbusClient::resetRoundTripEstimate()
+{
+    m_smoothedRttUs = -1;
+    m_rttVariationUs = 0;
+    m_replyTimeoutMs = qBound(m_minReplyTimeoutMs, m_timeoutMs > 0 ? m_timeoutMs : 1000, m_maxReplyTimeoutMs);
+}
+
+void ModbusClient::addRoundTripSample(qint64 sampleUs)
+{
+    if (m_smoothedRttUs < 0) {
+        m_smoothedRttUs = sampleUs;
+        m_rttVariationUs = sampleUs / 2;
+    } else {
+        // RFC 6298 gains: 1/8 for the mean, 1/4 for the deviation.
+        m_rttVariationUs += (qAbs(sampleUs - m_smoothedRttUs) - m_rttVariationUs) / 4;
+        m_smoothedRttUs += (sampleUs - m_smoothedRttUs) / 8;
+    }
+
+    const qint64 timeoutUs = m_smoothedRttUs + 4 * m_rttVariationUs;
+    m_replyTimeoutMs = int(qBound<qint64>(m_minReplyTimeoutMs, (timeoutUs + 999) / 1000, m_maxReplyTimeoutMs));
+
+    const qint64 now = m_clock.elapsed();
+    if (now - m_lastRttReportMs >= 500) {
+        m_lastRttReportMs = now;
+        emit roundTripTimeChanged(int(m_smoothedRttUs), int(m_rttVariationUs), m_replyTimeoutMs);
+    }
+}
+
+void ModbusClient::backOffReplyTimeout()
+{
+    // A lost reply gives no sample (Karn); back off until the next answered request.
+    m_replyTimeoutMs = qMin(m_replyTimeoutMs * 2, m_maxReplyTimeoutMs);
 }
 
 bool ModbusClient::connectDevice(const QString &host, quint16 port)
 {
+    if (host != m_host || port != m_port) {
+        // Another device may well implement FC23.
+        m_readWriteSupported = true;
+    }
     setConnectionParameters(host, port);
 
-    if (!m_client) {
+    if (!m_transport) {
         handleError(tr("Unable to connect: Modbus client is unavailable."));
         return false;
     }
@@ -137,16 +433,15 @@ bool ModbusClient::connectDevice(const QString &host, quint16 port)
         return false;
     }
 
-    if (m_client->state() == QModbusDevice::ConnectedState) {
+    if (m_transport->state() == ModbusTransport::Connected) {
         return true;
     }
 
-    if (m_client->state() == QModbusDevice::ConnectingState) {
-        recreateClient();
-        setConnectionParameters(host, port, m_timeoutMs);
+    if (m_transport->state() == ModbusTransport::Connecting) {
+        m_transport->abort();
     }
 
-    if (!m_client->connectDevice()) {
+    if (!m_transport->connectDevice()) {
         handleError(tr("Failed to connect to %1:%2").arg(m_host).arg(m_port));
         return false;
     }
@@ -157,7 +452,7 @@ bool ModbusClient::connectDevice(const QString &host, quint16 port)
 
 void ModbusClient::disconnectDevice()
 {
-    if (!m_client) {
+    if (!m_transport) {
         return;
     }
 
@@ -165,25 +460,147 @@ void ModbusClient::disconnectDevice()
         m_connectTimeoutTimer->stop();
     }
 
-    if (m_client->state() != QModbusDevice::UnconnectedState) {
-        m_client->disconnectDevice();
-    }
+    m_transport->disconnectDevice();
 }
 
 bool ModbusClient::isConnected() const
 {
-    return m_client && m_client->state() == QModbusDevice::ConnectedState;
+    return m_transport && m_transport->state() == ModbusTransport::Connected;
 }
 
 void ModbusClient::readHoldingRegisters(int startAddress, quint16 numberOfEntries, int serverAddress)
 {
-    if (!m_client) {
+    readHoldingRegisters(startAddress, numberOfEntries, nullptr, {}, serverAddress);
+}
+
+void ModbusClient::readHoldingRegisters(int startAddress,
+                                        quint16 numberOfEntries,
+                                        QObject *context,
+                                        ModbusCallback callback,
+                                        int serverAddress,
+                                        ReadSource source)
+{
+    if (!m_transport) {
         handleError(tr("Unable to read holding registers: Modbus client is unavailable."));
         return;
     }
 
-    enqueueMessage(startAddress, numberOfEntries, {}, serverAddress, true);
-    startDispatchTimerIfNeeded();
+    const Completion completion{context, std::move(callback), context != nullptr};
+    if (source == ReadSource::Capture) {
+        Transaction transaction;
+        transaction.isRead = true;
+        transaction.isCapture = true;
+        transaction.startAddress = startAddress;
+        transaction.numberOfEntries = numberOfEntries;
+        transaction.serverAddress = serverAddress;
+        transaction.enqueuedNs = m_clock.nsecsElapsed();
+        transaction.parts.append({startAddress, numberOfEntries, {completion}});
+        m_captureReads.append(transaction);
+        updateQueueGauges();
+        scheduleDispatch();
+        return;
+    }
+    if (source == ReadSource::AllowCached
+        && completeFromRegisterImage(startAddress, numberOfEntries, serverAddress, completion)) {
+        return;
+    }
+
+    enqueueRead(startAddress, numberOfEntries, serverAddress, completion);
+    scheduleDispatch();
+}
+
+int ModbusClient::subscribe(int startAddress,
+                            quint16 numberOfEntries,
+                            QObject *context,
+                            ModbusCallback callback,
+                            int serverAddress,
+                            SubscriptionRouter::Delivery delivery)
+{
+    const int id = m_subscriptions.subscribe(context, serverAddress, startAddress, numberOfEntries, callback, delivery);
+    if (id == 0 || serverAddress != kImageServerAddress) {
+        return id;
+    }
+
+    // Otherwise each register is delivered with the first reply that covers it.
+    QVector<quint16> values;
+    if (m_registerImage.freshValues(startAddress, numberOfEntries, 0, &values)) {
+        m_subscriptions.deliver(id, startAddress, values);
+    }
+    return id;
+}
+
+void ModbusClient::unsubscribe(int subscriptionId)
+{
+    m_subscriptions.unsubscribe(subscriptionId);
+}
+
+void ModbusClient::unsubscribe(QObject *context)
+{
+    m_subscriptions.unsubscribe(context);
+}
+
+void ModbusClient::cancelRequests(QObject *owner)
+{
+    if (!owner) {
+        return;
+    }
+
+    const auto withdraw = [owner](Transaction &transaction) {
+        for (RequestPart &part : transaction.parts) {
+            for (Completion &completion : part.completions) {
+                if (completion.owned && completion.context == owner) {
+                    completion.context.clear();
+                }
+            }
+        }
+    };
+    for (Transaction &transaction : m_readQueue) {
+        withdraw(transaction);
+    }
+    for (Transaction &transaction : m_plannedReads) {
+        withdraw(transaction);
+    }
+    for (Transaction &transaction : m_captureReads) {
+        withdraw(transaction);
+    }
+    for (InFlightTransaction &inFlight : m_inFlight) {
+        if (inFlight.transaction.isRead) {
+            withdraw(inFlight.transaction);
+        }
+    }
+
+    dropUnwantedReads(m_readQueue);
+    dropUnwantedReads(m_plannedReads);
+    dropUnwantedReads(m_captureReads);
+    updateQueueGauges();
+}
+
+bool ModbusClient::isWanted(const Transaction &transaction)
+{
+    if (!transaction.isRead || transaction.isHeartbeat) {
+        return true;
+    }
+    for (const RequestPart &part : transaction.parts) {
+        for (const Completion &completion : part.completions) {
+            if (!completion.owned || completion.context) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void ModbusClient::dropUnwantedReads(QList<Transaction> &queue)
+{
+    const auto unwanted = std::remove_if(queue.begin(), queue.end(), [](const Transaction &transaction) {
+        return !isWanted(transaction);
+    });
+    const int removed = int(queue.end() - unwanted);
+    queue.erase(unwanted, queue.end());
+    if (removed > 0) {
+        qCDebug(lcModbusClient) << "Dropped" << removed << "reads nobody waits for";
+        m_metrics.increment(ModbusMetrics::CancelledReads, quint64(removed));
+    }
 }
 
 void ModbusClient::writeSingleRegister(int address, quint16 value, int serverAddress)
@@ -194,185 +611,781 @@ void ModbusClient::writeSingleRegister(int address, quint16 value, int serverAdd
 
 void ModbusClient::writeMultipleRegisters(int startAddress, const QVector<quint16> &values, int serverAddress)
 {
-    if (!m_client) {
+    writeMultipleRegisters(startAddress, values, nullptr, {}, serverAddress);
+}
+
+void ModbusClient::writeMultipleRegisters(int startAddress,
+                                          const QVector<quint16> &values,
+                                          QObject *context,
+                                          ModbusCallback callback,
+                                          int serverAddress,
+                                          WriteConfirmation confirmation)
+{
+    if (!m_transport) {
         handleError(tr("Unable to write registers: Modbus client is unavailable."));
         return;
     }
 
-    enqueueMessage(startAddress, static_cast<quint16>(values.size()), values, serverAddress, false);
-    startDispatchTimerIfNeeded();
+    if (confirmation == WriteConfirmation::Acknowledge) {
+        enqueueWrite(startAddress, values, serverAddress, {context, std::move(callback)});
+        scheduleDispatch();
+        return;
+    }
+
+    enqueueWriteThenRead(startAddress,
+                         values,
+                         startAddress,
+                         static_cast<quint16>(values.size()),
+                         serverAddress,
+                         {context, std::move(callback)});
+    scheduleDispatch();
 }
 
-void ModbusClient::handleReplyFinished(QModbusReply *reply, bool isReadOperation)
+void ModbusClient::readWriteMultipleRegisters(int writeStartAddress,
+                                              const QVector<quint16> &values,
+                                              int readStartAddress,
+                                              quint16 readNumberOfEntries,
+                                              QObject *context,
+                                              ModbusCallback callback,
+                                              int serverAddress)
 {
-    if (!reply) {
+    if (!m_transport) {
+        handleError(tr("Unable to read/write registers: Modbus client is unavailable."));
         return;
     }
 
-    if (reply->error() == QModbusDevice::NoError) {
-        if (isReadOperation) {
-            const QModbusDataUnit unit = reply->result();
-            QVector<quint16> values(unit.valueCount());
-            for (uint i = 0; i < unit.valueCount(); ++i) {
-                values[static_cast<int>(i)] = unit.value(i);
-            }
-            // qDebug() << unit.startAddress() << values;
-            emit readCompleted(unit.startAddress(), values);
+    const Completion completion{context, std::move(callback)};
+    if (!m_readWriteSupported || values.isEmpty() || values.size() > kMaxReadWriteWriteRegisters) {
+        enqueueWriteThenRead(writeStartAddress, values, readStartAddress, readNumberOfEntries, serverAddress, completion);
+        scheduleDispatch();
+        return;
+    }
+
+    Transaction transaction;
+    transaction.isRead = false;
+    transaction.isReadWrite = true;
+    transaction.startAddress = writeStartAddress;
+    transaction.numberOfEntries = static_cast<quint16>(values.size());
+    transaction.values = values;
+    transaction.serverAddress = serverAddress;
+    transaction.enqueuedNs = m_clock.nsecsElapsed();
+    if (m_writeExpiryMs > 0) {
+        transaction.expiresMs = m_clock.elapsed() + m_writeExpiryMs;
+    }
+    transaction.writeSequence = ++m_writeSequence;
+    transaction.readStartAddress = readStartAddress;
+    transaction.readNumberOfEntries = readNumberOfEntries;
+    transaction.readParts.append({readStartAddress, readNumberOfEntries, {completion}});
+    m_writeQueue.append(transaction);
+    updateQueueGauges();
+    scheduleDispatch();
+}
+
+void ModbusClient::handleTransportFinished(quint16 transactionId, const ModbusResult &result)
+{
+    const auto it = m_inFlight.constFind(transactionId);
+    if (it == m_inFlight.constEnd()) {
+        return;
+    }
+    ModbusResult received = result;
+    received.receivedUs = ModbusResult::monotonicUs();
+    recordOutcome(*it, received);
+    // Exception responses are answers too; aborted and timed out requests are not.
+    if (result.isOk() || result.status == ModbusResult::ProtocolError) {
+        addRoundTripSample((m_clock.nsecsElapsed() - it->sentNs) / 1000);
+        m_lastReplyMs = m_clock.elapsed();
+        m_heartbeatMisses = 0;
+    }
+    handleReplyFinished(it->transaction, received);
+    onReplySettled(transactionId);
+}
+
+void ModbusClient::handleReplyFinished(const Transaction &transaction, ModbusResult result)
+{
+    if (transaction.isCapture) {
+        // Samples belong to the recorder alone, which records a failed one as a gap.
+        if (isWanted(transaction)) {
+            completeTransaction(transaction, result);
         } else {
-            const QModbusDataUnit unit = reply->result();
-            emit writeCompleted(unit.startAddress(), unit.valueCount());
+            m_metrics.increment(ModbusMetrics::CancelledReads);
         }
-    } else if (reply->error() == QModbusDevice::ProtocolError) {
-        handleError(tr("Modbus reply protocol error: %1 (exception code: 0x%2)")
-                        .arg(reply->errorString())
-                        .arg(reply->rawResult().exceptionCode(), 0, 16),
-                    reply);
-    } else if (reply->error() == QModbusDevice::ReplyAbortedError) {
-        // Специальная обработка ошибки закрытия соединения
-        QString operation = isReadOperation ? tr("read") : tr("write");
-        handleError(tr("Modbus %1 operation aborted: connection was closed during request. "
-                       "The device may have disconnected or the connection timed out. "
-                       "Please check the connection and try again.")
-                        .arg(operation),
-                    reply);
-    } else {
-        handleError(tr("Modbus reply error: %1").arg(reply->errorString()), reply);
+        return;
+    }
+
+    if (!isWanted(transaction)) {
+        // Every requester went away while it was in flight: skip retries and signals.
+        // Subscribers still get what changed, the image will not report it again.
+        QBitArray readChanged;
+        updateRegisterImage(transaction, result, nullptr, &readChanged);
+        routeToSubscribers(transaction, result, {}, readChanged);
+        m_metrics.increment(ModbusMetrics::CancelledReads);
+        return;
+    }
+
+    if (fallBackFromReadWrite(transaction, result) || retryTransaction(transaction, result)) {
+        return;
+    }
+
+    // FC23 replies describe the read range, like plain reads.
+    const bool isReadOperation = transaction.isRead;
+    if ((!isReadOperation && !transaction.isReadWrite) || !result.isOk()) {
+        result.startAddress = transaction.startAddress;
+        result.numberOfEntries = transaction.numberOfEntries;
+    }
+
+    if (!result.isOk()) {
+        handleError(result.errorString);
+    } else if (!isReadOperation) {
+        emit writeCompleted(transaction.startAddress, transaction.numberOfEntries);
+    }
+
+    // Diffed against the image in this thread, so consumers only redraw what changed.
+    QBitArray writeChanged;
+    QBitArray readChanged;
+    updateRegisterImage(transaction, result, &writeChanged, &readChanged);
+    if (result.isOk() && (isReadOperation || transaction.isReadWrite) && m_awaitingFirstData) {
+        m_awaitingFirstData = false;
+        m_timeToFirstDataMs.storeRelaxed(int(m_clock.elapsed() - m_connectedAtMs));
+        emit firstDataAfterConnect(m_timeToFirstDataMs.loadRelaxed());
+    }
+    routeToSubscribers(transaction, result, writeChanged, readChanged);
+    completeTransaction(transaction, result);
+}
+
+void ModbusClient::routeToSubscribers(const Transaction &transaction,
+                                      const ModbusResult &result,
+                                      const QBitArray &writeChanged,
+                                      const QBitArray &readChanged)
+{
+    if (!result.isOk()) {
+        return;
+    }
+    if (!transaction.isRead) {
+        // The device accepted the values, so show them without reading them back.
+        m_subscriptions.route(transaction.serverAddress, transaction.startAddress, transaction.values, writeChanged);
+    }
+    if (transaction.isRead || transaction.isReadWrite) {
+        m_subscriptions.route(transaction.serverAddress, result.startAddress, result.values, readChanged);
     }
 }
 
-void ModbusClient::handleError(const QString &context, QModbusReply *reply)
+bool ModbusClient::retryTransaction(const Transaction &transaction, const ModbusResult &result)
 {
-    QString detailedContext = context;
-    if (reply) {
-        detailedContext += tr(" [code=%1]").arg(reply->error());
+    if (result.status != ModbusResult::Timeout && result.status != ModbusResult::Error) {
+        return false;
+    }
+    if (transaction.isFused) {
+        // Fusion is an optimisation, it must not cost the read its retries. Each half goes
+        // back through the reply path under its own policy.
+        Transaction write;
+        Transaction read;
+        splitReadWrite(transaction, &write, &read);
+        handleReplyFinished(write, result);
+        handleReplyFinished(read, result);
+        return true;
+    }
+    if (transaction.isHeartbeat || (!transaction.isRead && !m_retryWrites)) {
+        return false;
+    }
+
+    if (transaction.attempt >= m_maxRetries || !isConnected()) {
+        if (transaction.attempt > 0) {
+            m_metrics.increment(ModbusMetrics::FailedAfterRetries);
+        }
+        return false;
     }
 
-    qCWarning(lcModbusClient) << detailedContext;
-    emit errorOccurred(detailedContext);
+    // Exponential backoff with +-50% jitter so retries of a burst of lost requests spread out.
+    const int backoffMs = m_retryBackoffMs << transaction.attempt;
+    const int delayMs = backoffMs / 2 + int(QRandomGenerator::global()->bounded(backoffMs + 1));
+    const qint64 deadlineMs = transaction.enqueuedNs / 1000000 + m_retryCycleDeadlineMs;
+    if (m_clock.elapsed() + delayMs + m_replyTimeoutMs > deadlineMs) {
+        if (transaction.attempt > 0) {
+            m_metrics.increment(ModbusMetrics::FailedAfterRetries);
+        }
+        return false;
+    }
+
+    qCDebug(lcModbusClient) << "Retrying" << (transaction.isRead ? "read" : "write") << "at"
+                            << transaction.startAddress << "in" << delayMs << "ms:" << result.errorString;
+    m_metrics.increment(ModbusMetrics::Retries);
+
+    Transaction retry = transaction;
+    ++retry.attempt;
+    QTimer::singleShot(delayMs, this, [this, retry]() {
+        // Retries go ahead of the queued reads, the data they carry is already due.
+        if (retry.isRead) {
+            m_plannedReads.prepend(retry);
+        } else {
+            requeueWrites({retry});
+        }
+        scheduleDispatch();
+    });
+    return true;
 }
 
-void ModbusClient::enqueueMessage(int address,
-                                  quint16 numberOfEntries,
-                                  const QVector<quint16> &values,
-                                  int serverAddress,
-                                  bool isRead)
+void ModbusClient::completeTransaction(const Transaction &transaction, const ModbusResult &result)
 {
-    QueuedMessage message;
-    message.isRead = isRead;
-    message.numberOfEntries = numberOfEntries;
-    message.values = values;
-    message.serverAddress = serverAddress;
+    completeParts(transaction.parts, transaction.isRead, result);
+    if (transaction.isReadWrite) {
+        completeParts(transaction.readParts, true, result);
+    }
+}
+
+void ModbusClient::completeParts(const QVector<RequestPart> &parts, bool isRead, const ModbusResult &result)
+{
+    for (const RequestPart &part : parts) {
+        ModbusResult partResult;
+        partResult.status = result.status;
+        partResult.startAddress = part.startAddress;
+        partResult.numberOfEntries = part.numberOfEntries;
+        partResult.exceptionCode = result.exceptionCode;
+        partResult.errorString = result.errorString;
+        partResult.receivedUs = result.receivedUs;
+
+        if (result.isOk() && isRead) {
+            // Split the merged reply back into the ranges that were originally requested.
+            const int offset = part.startAddress - result.startAddress;
+            if (offset < 0 || offset + part.numberOfEntries > result.values.size()) {
+                qCWarning(lcModbusClient) << "Reply does not cover requested range at" << part.startAddress;
+                partResult.status = ModbusResult::Error;
+                partResult.errorString = tr("Reply does not cover requested range");
+            } else {
+                partResult.values = result.values.mid(offset, part.numberOfEntries);
+                if (isSignalConnected(QMetaMethod::fromSignal(&ModbusClient::readCompleted))) {
+                    emit readCompleted(part.startAddress, partResult.values.toVector());
+                }
+            }
+        }
 
-    if (!m_messageQueue.contains(address)) {
-        m_messageOrder.append(address);
+        for (const Completion &completion : part.completions) {
+            if (!completion.context || !completion.callback) {
+                continue;
+            }
+            QMetaObject::invokeMethod(
+                completion.context,
+                [callback = completion.callback, partResult]() {
+                    callback(partResult);
+                },
+                Qt::QueuedConnection);
+        }
     }
-    m_messageQueue.insert(address, message);
 }
 
-void ModbusClient::dispatchQueuedMessages()
+void ModbusClient::updateRegisterImage(const Transaction &transaction,
+                                       const ModbusResult &result,
+                                       QBitArray *writeChanged,
+                                       QBitArray *readChanged)
 {
-    if (m_isDispatching || !isConnected() || m_messageQueue.isEmpty()) {
+    if (transaction.serverAddress != kImageServerAddress) {
         return;
     }
 
-    m_pendingDispatch = m_messageOrder;
-    m_isDispatching = true;
-    sendNextQueuedMessage();
+    if (!result.isOk()) {
+        m_registerImage.markBad(transaction.startAddress, transaction.numberOfEntries);
+        if (transaction.isReadWrite) {
+            m_registerImage.markBad(transaction.readStartAddress, transaction.readNumberOfEntries);
+        }
+    } else if (transaction.isRead) {
+        m_registerImage.update(result.startAddress, result.values, readChanged);
+    } else {
+        m_registerImage.update(transaction.startAddress, transaction.values, writeChanged);
+        m_lastWriteAckMs = RegisterImage::monotonicMs();
+        if (transaction.isReadWrite) {
+            // Read after the write, so it wins where the ranges overlap.
+            m_registerImage.update(result.startAddress, result.values, readChanged);
+        }
+    }
 }
 
-void ModbusClient::sendNextQueuedMessage()
+bool ModbusClient::completeFromRegisterImage(int startAddress,
+                                             quint16 numberOfEntries,
+                                             int serverAddress,
+                                             const Completion &completion)
 {
-    if (!isConnected()) {
-        m_isDispatching = false;
-        return;
+    if (m_cacheMaxAgeMs <= 0 || serverAddress != kImageServerAddress) {
+        return false;
     }
 
-    if (m_activeReply) {
-        return;
+    // A write may change any register on the device, so only values read after the
+    // last acknowledged write are served.
+    const qint64 notBeforeMs = qMax(RegisterImage::monotonicMs() - m_cacheMaxAgeMs, m_lastWriteAckMs);
+
+    QVector<quint16> values;
+    if (!m_registerImage.freshValues(startAddress, numberOfEntries, notBeforeMs, &values)) {
+        return false;
+    }
+    ModbusResult result;
+    result.values = values;
+    result.startAddress = startAddress;
+    result.numberOfEntries = numberOfEntries;
+
+    Transaction transaction;
+    transaction.isRead = true;
+    transaction.startAddress = startAddress;
+    transaction.numberOfEntries = numberOfEntries;
+    transaction.serverAddress = serverAddress;
+    transaction.parts.append({startAddress, numberOfEntries, {completion}});
+    completeTransaction(transaction, result);
+    m_metrics.increment(ModbusMetrics::ServedFromCache);
+    return true;
+}
+
+void ModbusClient::handleError(const QString &context)
+{
+    qCWarning(lcModbusClient) << context;
+    emit errorOccurred(context);
+}
+
+void ModbusClient::enqueueRead(int startAddress, quint16 numberOfEntries, int serverAddress, const Completion &completion)
+{
+    for (Transaction &queued : m_readQueue) {
+        if (queued.startAddress == startAddress
+            && queued.numberOfEntries == numberOfEntries
+            && queued.serverAddress == serverAddress) {
+            // The read already waiting in the queue serves this request as well.
+            queued.parts.first().completions.append(completion);
+            m_metrics.increment(ModbusMetrics::CoalescedReads);
+            return;
+        }
+    }
+    for (Transaction &planned : m_plannedReads) {
+        if (planned.serverAddress == serverAddress
+            && startAddress >= planned.startAddress
+            && startAddress + numberOfEntries <= planned.startAddress + planned.numberOfEntries) {
+            // Not sent yet either, so its reply is as fresh as a new request would be.
+            planned.parts.append({startAddress, numberOfEntries, {completion}});
+            m_metrics.increment(ModbusMetrics::CoalescedReads);
+            return;
+        }
     }
 
-    if (m_pendingDispatch.isEmpty()) {
-        m_messageQueue.clear();
-        m_messageOrder.clear();
-        m_isDispatching = false;
+    if (m_maxQueuedReads > 0 && m_readQueue.size() + m_plannedReads.size() >= m_maxQueuedReads) {
+        dropOldestQueuedRead();
+    }
+
+    Transaction transaction;
+    transaction.isRead = true;
+    transaction.startAddress = startAddress;
+    transaction.numberOfEntries = numberOfEntries;
+    transaction.serverAddress = serverAddress;
+    transaction.enqueuedNs = m_clock.nsecsElapsed();
+    transaction.parts.append({startAddress, numberOfEntries, {completion}});
+    m_readQueue.append(transaction);
+    updateQueueGauges();
+}
+
+void ModbusClient::enqueueWrite(int startAddress, const QVector<quint16> &values, int serverAddress, const Completion &completion)
+{
+    const RequestPart part{startAddress, static_cast<quint16>(values.size()), {completion}};
+    if (combineWrite(startAddress, values, serverAddress, part)) {
         return;
     }
 
-    const int address = m_pendingDispatch.takeFirst();
-    const QueuedMessage message = m_messageQueue.value(address);
+    Transaction transaction;
+    transaction.isRead = false;
+    transaction.startAddress = startAddress;
+    transaction.numberOfEntries = static_cast<quint16>(values.size());
+    transaction.values = values;
+    transaction.serverAddress = serverAddress;
+    transaction.enqueuedNs = m_clock.nsecsElapsed();
+    if (m_writeExpiryMs > 0) {
+        transaction.expiresMs = m_clock.elapsed() + m_writeExpiryMs;
+    }
+    transaction.writeSequence = ++m_writeSequence;
+    transaction.parts.append(part);
+    m_writeQueue.append(transaction);
+    updateQueueGauges();
+}
 
-    QModbusReply *reply = nullptr;
-    if (message.isRead) {
-        reply = sendReadRequest(address, message.numberOfEntries, message.serverAddress);
-    } else {
-        reply = sendWriteRequest(address, message.values, message.serverAddress);
+bool ModbusClient::combineWrite(int startAddress, const QVector<quint16> &values, int serverAddress, const RequestPart &part)
+{
+    const int endAddress = startAddress + values.size();
+    bool isLatestForServer = true;
+
+    // Walk back from the newest unsent write. Later values always win, and a write is
+    // never moved ahead of an unsent write it overlaps.
+    for (int i = m_writeQueue.size() - 1; i >= 0; --i) {
+        Transaction &queued = m_writeQueue[i];
+        if (queued.serverAddress != serverAddress) {
+            continue;
+        }
+
+        const int queuedEnd = queued.startAddress + queued.numberOfEntries;
+        const bool overlaps = startAddress < queuedEnd && endAddress > queued.startAddress;
+        if (queued.isReadWrite) {
+            // Its read must see exactly the writes queued before it.
+            const int readEnd = queued.readStartAddress + queued.readNumberOfEntries;
+            if (overlaps || (startAddress < readEnd && endAddress > queued.readStartAddress)) {
+                return false;
+            }
+            isLatestForServer = false;
+            continue;
+        }
+        if (startAddress >= queued.startAddress && endAddress <= queuedEnd) {
+            // Already covered: just replace the values and keep the queue position.
+            std::copy(values.cbegin(), values.cend(), queued.values.begin() + (startAddress - queued.startAddress));
+            queued.writeSequence = ++m_writeSequence;
+            queued.parts.append(part);
+            qCDebug(lcModbusClient) << "Coalesced write at" << startAddress << "into pending write at" << queued.startAddress;
+            return true;
+        }
+
+        // Extending a range only happens on the newest write, so writes to unrelated
+        // registers keep their relative order.
+        const int mergedStart = qMin(startAddress, queued.startAddress);
+        const int mergedEnd = qMax(endAddress, queuedEnd);
+        if (isLatestForServer
+            && startAddress <= queuedEnd && endAddress >= queued.startAddress
+            && mergedEnd - mergedStart <= kMaxWriteRegisters) {
+            QVector<quint16> merged(mergedEnd - mergedStart);
+            std::copy(queued.values.cbegin(), queued.values.cend(), merged.begin() + (queued.startAddress - mergedStart));
+            std::copy(values.cbegin(), values.cend(), merged.begin() + (startAddress - mergedStart));
+            queued.startAddress = mergedStart;
+            queued.numberOfEntries = static_cast<quint16>(merged.size());
+            queued.values = merged;
+            queued.writeSequence = ++m_writeSequence;
+            queued.parts.append(part);
+            qCDebug(lcModbusClient) << "Combined write at" << startAddress << "into" << queued.numberOfEntries
+                                    << "registers at" << queued.startAddress;
+            return true;
+        }
+
+        if (overlaps) {
+            return false;
+        }
+        isLatestForServer = false;
     }
+    return false;
+}
 
-    if (!reply) {
-        // Failed to send, move on to the next message to avoid blocking the queue.
-        QTimer::singleShot(0, this, [this]() {
-            sendNextQueuedMessage();
-        });
-        return;
+void ModbusClient::requeueWrites(QList<Transaction> writes)
+{
+    // Sent again ahead of the queue, in the order their values were queued.
+    std::sort(writes.begin(), writes.end(), [](const Transaction &a, const Transaction &b) {
+        return a.writeSequence < b.writeSequence;
+    });
+    for (int i = int(writes.size()) - 1; i >= 0; --i) {
+        m_writeQueue.prepend(writes.at(i));
     }
 
-    m_activeReply = reply;
+    for (int i = 0, count = int(writes.size()); i < count;) {
+        if (absorbIntoNewerWrites(m_writeQueue[i])) {
+            m_writeQueue.removeAt(i);
+            --count;
+        } else {
+            ++i;
+        }
+    }
+    updateQueueGauges();
+}
 
-    connect(reply, &QModbusReply::finished, this, [this, reply, isRead = message.isRead]() {
-        if (reply != m_activeReply) {
-            return;
+bool ModbusClient::absorbIntoNewerWrites(Transaction &write)
+{
+    const int endAddress = write.startAddress + write.numberOfEntries;
+    QVector<Transaction *> newer;
+    const auto collect = [&](Transaction &candidate) {
+        if (&candidate != &write && !candidate.isRead && candidate.serverAddress == write.serverAddress
+            && candidate.writeSequence > write.writeSequence
+            && candidate.startAddress < endAddress
+            && candidate.startAddress + candidate.numberOfEntries > write.startAddress) {
+            newer.append(&candidate);
         }
-        handleReplyFinished(reply, isRead);
-        reply->deleteLater();
-        m_activeReply.clear();
-        onReplySettled();
+    };
+    for (Transaction &queued : m_writeQueue) {
+        collect(queued);
+    }
+    for (InFlightTransaction &inFlight : m_inFlight) {
+        collect(inFlight.transaction);
+    }
+    std::sort(newer.begin(), newer.end(), [](const Transaction *a, const Transaction *b) {
+        return a->writeSequence < b->writeSequence;
     });
 
-    startReplyTimeout();
+    // Whatever is sent first, the registers end up with the newest values.
+    for (const Transaction *candidate : std::as_const(newer)) {
+        const int from = qMax(write.startAddress, candidate->startAddress);
+        const int to = qMin(endAddress, candidate->startAddress + candidate->numberOfEntries);
+        for (int address = from; address < to; ++address) {
+            write.values[address - write.startAddress] = candidate->values.at(address - candidate->startAddress);
+        }
+    }
+
+    // A write entirely covered by a newer one is not sent again; its callers get the
+    // outcome of the newer write. FC23 writes still have their read to do.
+    if (write.isReadWrite) {
+        return false;
+    }
+    for (Transaction *candidate : std::as_const(newer)) {
+        if (candidate->startAddress <= write.startAddress
+            && candidate->startAddress + candidate->numberOfEntries >= endAddress) {
+            qCDebug(lcModbusClient) << "Dropped stale write at" << write.startAddress << "superseded by write at"
+                                    << candidate->startAddress;
+            candidate->parts.append(write.parts);
+            return true;
+        }
+    }
+    return false;
 }
 
-QModbusReply *ModbusClient::sendReadRequest(int startAddress, quint16 numberOfEntries, int serverAddress)
+bool ModbusClient::isWriteDue() const
 {
-    if (!m_client || m_client->state() != QModbusDevice::ConnectedState) {
-        return nullptr;
+    if (m_writeQueue.isEmpty()) {
+        return false;
     }
+    return m_clock.nsecsElapsed() - m_writeQueue.first().enqueuedNs >= qint64(m_writeCombiningWindowUs) * 1000;
+}
 
-    if (auto reply = m_client->sendReadRequest(
-            QModbusDataUnit(QModbusDataUnit::HoldingRegisters, startAddress, numberOfEntries),
-            serverAddress)) {
-        return reply;
-    } else {
-        handleError(tr("Failed to send read request: %1").arg(m_client->errorString()));
-        return nullptr;
+void ModbusClient::enqueueWriteThenRead(int writeStartAddress,
+                                        const QVector<quint16> &values,
+                                        int readStartAddress,
+                                        quint16 readNumberOfEntries,
+                                        int serverAddress,
+                                        const Completion &completion)
+{
+    // The read is queued once the write is acknowledged and bypasses the register
+    // image, which already holds the written values.
+    const auto onWritten = [this, readStartAddress, readNumberOfEntries, serverAddress, completion](
+                               const ModbusResult &result) {
+        if (!result.isOk()) {
+            if (completion.context && completion.callback) {
+                QMetaObject::invokeMethod(
+                    completion.context,
+                    [callback = completion.callback, result]() {
+                        callback(result);
+                    },
+                    Qt::QueuedConnection);
+            }
+            return;
+        }
+        enqueueRead(readStartAddress, readNumberOfEntries, serverAddress, completion);
+        scheduleDispatch();
+    };
+    enqueueWrite(writeStartAddress, values, serverAddress, {this, onWritten});
+}
+
+void ModbusClient::fuseWithNextRead(Transaction &write)
+{
+    if (!m_readWriteFusion || !m_readWriteSupported || write.isReadWrite || write.isHeartbeat
+        || write.numberOfEntries > kMaxReadWriteWriteRegisters || isWriteDue()) {
+        return;
+    }
+
+    // Only the read that would go out right after this write is fused, so the device
+    // sees the same order either way.
+    if (m_plannedReads.isEmpty()) {
+        planQueuedReads();
     }
+    if (m_plannedReads.isEmpty() || m_plannedReads.first().serverAddress != write.serverAddress
+        || !isWanted(m_plannedReads.first())) {
+        return;
+    }
+
+    const Transaction read = m_plannedReads.takeFirst();
+    write.isReadWrite = true;
+    write.isFused = true;
+    write.readStartAddress = read.startAddress;
+    write.readNumberOfEntries = read.numberOfEntries;
+    write.readParts = read.parts;
+    qCDebug(lcModbusClient) << "Fused write at" << write.startAddress << "with read at" << read.startAddress;
 }
 
-QModbusReply *ModbusClient::sendWriteRequest(int startAddress,
-                                            const QVector<quint16> &values,
-                                            int serverAddress)
+bool ModbusClient::fallBackFromReadWrite(const Transaction &transaction, const ModbusResult &result)
 {
-    if (!m_client || m_client->state() != QModbusDevice::ConnectedState) {
-        return nullptr;
+    if (!transaction.isReadWrite || result.status != ModbusResult::ProtocolError
+        || result.exceptionCode != kIllegalFunction) {
+        return false;
     }
 
-    QModbusDataUnit dataUnit(QModbusDataUnit::HoldingRegisters, startAddress, values.size());
-    for (int i = 0; i < values.size(); ++i) {
-        dataUnit.setValue(i, values.at(i));
+    qCInfo(lcModbusClient) << "Device rejected FC23, sending writes and reads separately";
+    m_readWriteSupported = false;
+
+    // Writes go out before planned reads, which keeps the write-then-read order.
+    Transaction write;
+    Transaction read;
+    splitReadWrite(transaction, &write, &read);
+    m_writeQueue.prepend(write);
+    m_plannedReads.prepend(read);
+    updateQueueGauges();
+    scheduleDispatch();
+    return true;
+}
+
+void ModbusClient::splitReadWrite(const Transaction &transaction, Transaction *write, Transaction *read)
+{
+    *write = transaction;
+    write->isReadWrite = false;
+    write->isFused = false;
+    write->readParts.clear();
+
+    *read = Transaction();
+    read->isRead = true;
+    read->startAddress = transaction.readStartAddress;
+    read->numberOfEntries = transaction.readNumberOfEntries;
+    read->serverAddress = transaction.serverAddress;
+    read->enqueuedNs = transaction.enqueuedNs;
+    read->attempt = transaction.attempt;
+    read->parts = transaction.readParts;
+}
+
+void ModbusClient::dispatchQueuedMessages()
+{
+    if (!isConnected() || (m_writeQueue.isEmpty() && m_readQueue.isEmpty() && m_plannedReads.isEmpty()
+                           && m_captureReads.isEmpty())) {
+        return;
     }
 
-    if (auto reply = m_client->sendWriteRequest(dataUnit, serverAddress)) {
-        return reply;
+    sendNextQueuedMessage();
+}
+
+void ModbusClient::planQueuedReads()
+{
+    dropUnwantedReads(m_readQueue);
+    if (m_readQueue.isEmpty()) {
+        return;
+    }
+
+    QVector<ModbusReadPlanner::ReadRange> reads;
+    reads.reserve(m_readQueue.size());
+    for (const Transaction &queued : std::as_const(m_readQueue)) {
+        reads.append({queued.serverAddress, queued.startAddress, queued.numberOfEntries});
+    }
+
+    const auto plannedReads = ModbusReadPlanner::plan(reads, m_gapFillThreshold);
+    for (const auto &planned : plannedReads) {
+        Transaction transaction;
+        transaction.isRead = true;
+        transaction.startAddress = planned.startAddress;
+        transaction.numberOfEntries = planned.numberOfEntries;
+        transaction.serverAddress = planned.serverAddress;
+        transaction.enqueuedNs = m_readQueue.at(planned.sources.first()).enqueuedNs;
+        for (const int source : planned.sources) {
+            const Transaction &queued = m_readQueue.at(source);
+            transaction.parts.append(queued.parts);
+            transaction.enqueuedNs = qMin(transaction.enqueuedNs, queued.enqueuedNs);
+        }
+        m_plannedReads.append(transaction);
+    }
+
+    qCDebug(lcModbusClient) << "Planned" << m_readQueue.size() << "reads into" << plannedReads.size() << "requests";
+    m_readQueue.clear();
+}
+
+void ModbusClient::sendNextQueuedMessage()
+{
+    if (!isConnected()) {
+        return;
+    }
+
+    // Keep up to m_maxInFlight transactions outstanding on the connection.
+    while (m_inFlight.size() < m_maxInFlight) {
+        Transaction transaction;
+        if (isWriteDue()) {
+            // Writes never wait behind planned poll reads, only behind the in-flight window
+            // and their combining window.
+            transaction = m_writeQueue.takeFirst();
+            if (dropIfExpired(transaction)) {
+                continue;
+            }
+            fuseWithNextRead(transaction);
+        } else if (!m_captureReads.isEmpty()) {
+            // At most one capture read per range is queued, and its timing is the point of it.
+            transaction = m_captureReads.takeFirst();
+            if (!isWanted(transaction)) {
+                m_metrics.increment(ModbusMetrics::CancelledReads);
+                continue;
+            }
+        } else {
+            if (m_plannedReads.isEmpty()) {
+                planQueuedReads();
+                if (m_plannedReads.isEmpty()) {
+                    break;
+                }
+            }
+            transaction = m_plannedReads.takeFirst();
+            if (!isWanted(transaction)) {
+                m_metrics.increment(ModbusMetrics::CancelledReads);
+                continue;
+            }
+        }
+
+        if (!sendTransaction(transaction)) {
+            // Failed to send, move on to the next message to avoid blocking the queue.
+            ModbusResult result;
+            result.status = ModbusResult::Error;
+            result.errorString = tr("Failed to send %1 request: %2")
+                                     .arg(transaction.isRead ? tr("read") : tr("write"))
+                                     .arg(m_transport->errorString());
+            handleError(result.errorString);
+            completeTransaction(transaction, result);
+        }
+    }
+
+    if (!m_writeQueue.isEmpty() && m_inFlight.size() < m_maxInFlight) {
+        // The oldest write is still inside its combining window.
+        scheduleDispatch();
+    }
+
+    updateQueueGauges();
+    rearmReplyTimeout();
+}
+
+bool ModbusClient::sendTransaction(const Transaction &transaction)
+{
+    const quint16 transactionId = m_nextTransactionId++;
+    bool sent = false;
+    if (transaction.isReadWrite) {
+        sent = m_transport->sendReadWriteRequest(transactionId,
+                                                 transaction.readStartAddress,
+                                                 transaction.readNumberOfEntries,
+                                                 transaction.startAddress,
+                                                 transaction.values,
+                                                 transaction.serverAddress);
+    } else if (transaction.isRead) {
+        sent = m_transport->sendReadRequest(transactionId,
+                                            transaction.startAddress,
+                                            transaction.numberOfEntries,
+                                            transaction.serverAddress);
     } else {
-        handleError(tr("Failed to send write request: %1").arg(m_client->errorString()));
-        return nullptr;
+        sent = m_transport->sendWriteRequest(transactionId,
+                                             transaction.startAddress,
+                                             transaction.values,
+                                             transaction.serverAddress);
+    }
+    if (!sent) {
+        return false;
     }
+
+    qCDebug(lcModbusClient) << "Dispatched" << (transaction.isReadWrite ? "read/write" : transaction.isRead ? "read" : "write")
+                            << "at" << transaction.startAddress << "after"
+                            << (m_clock.nsecsElapsed() - transaction.enqueuedNs) / 1000 << "us in queue";
+
+    InFlightTransaction inFlight;
+    inFlight.transaction = transaction;
+    inFlight.sentNs = m_clock.nsecsElapsed();
+    inFlight.deadlineMs = m_clock.elapsed() + m_replyTimeoutMs;
+    m_inFlight.insert(transactionId, inFlight);
+    m_metrics.increment(ModbusMetrics::Sent);
+    return true;
 }
 
-void ModbusClient::startDispatchTimerIfNeeded()
+void ModbusClient::scheduleDispatch()
 {
-    if (isConnected() && m_dispatchTimer && !m_dispatchTimer->isActive()) {
-        m_dispatchTimer->start();
+    if (!isConnected() || !m_dispatchTimer) {
+        return;
+    }
+
+    // Pending writes skip the batching window and only wait for their combining window.
+    // QTimer resolution is one millisecond, so windows are rounded up.
+    int delayMs = (m_batchingWindowUs + 999) / 1000;
+    if (!m_writeQueue.isEmpty()) {
+        const qint64 waitedUs = (m_clock.nsecsElapsed() - m_writeQueue.first().enqueuedNs) / 1000;
+        delayMs = int((qMax<qint64>(0, m_writeCombiningWindowUs - waitedUs) + 999) / 1000);
     }
+    if (m_dispatchTimer->isActive() && m_dispatchTimer->remainingTime() <= delayMs) {
+        return;
+    }
+    m_dispatchTimer->start(delayMs);
 }
 
 void ModbusClient::stopDispatching()
@@ -380,26 +1393,136 @@ void ModbusClient::stopDispatching()
     if (m_dispatchTimer) {
         m_dispatchTimer->stop();
     }
-    m_isDispatching = false;
-    m_pendingDispatch.clear();
 }
 
-void ModbusClient::onReplySettled()
+void ModbusClient::onReplySettled(quint16 transactionId)
 {
-    if (m_replyTimeout) {
-        m_replyTimeout->stop();
-    }
+    m_inFlight.remove(transactionId);
+    updateQueueGauges();
+    rearmReplyTimeout();
     QTimer::singleShot(0, this, [this]() {
         sendNextQueuedMessage();
     });
 }
 
-void ModbusClient::startReplyTimeout()
+void ModbusClient::handleReplyTimeouts()
+{
+    const qint64 now = m_clock.elapsed();
+
+    QList<quint16> expired;
+    for (auto it = m_inFlight.constBegin(); it != m_inFlight.constEnd(); ++it) {
+        if (it->deadlineMs <= now) {
+            expired.append(it.key());
+        }
+    }
+
+    if (!expired.isEmpty()) {
+        backOffReplyTimeout();
+    }
+
+    // Requests stalled together by one outage are one miss, however deep the pipeline.
+    bool missed = false;
+    for (const quint16 transactionId : expired) {
+        const InFlightTransaction inFlight = m_inFlight.value(transactionId);
+        missed = missed || inFlight.sentNs > m_lastMissNs;
+
+        ModbusResult result;
+        result.status = ModbusResult::Timeout;
+        result.errorString = tr("Modbus request timeout (transaction %1, address 0x%2)")
+                                 .arg(transactionId)
+                                 .arg(inFlight.transaction.startAddress, 0, 16);
+        m_transport->cancel(transactionId);
+        recordOutcome(inFlight, result);
+        handleReplyFinished(inFlight.transaction, result);
+        onReplySettled(transactionId);
+    }
+
+    // May drop the connection, so only after all expired transactions are settled.
+    if (missed) {
+        m_lastMissNs = m_clock.nsecsElapsed();
+        registerMiss();
+    }
+
+    rearmReplyTimeout();
+}
+
+void ModbusClient::rearmReplyTimeout()
 {
     if (!m_replyTimeout) {
         return;
     }
-    const int timeout = m_timeoutMs > 0 ? m_timeoutMs : 1000;
-    m_replyTimeout->start(timeout);
+
+    if (m_inFlight.isEmpty()) {
+        m_replyTimeout->stop();
+        return;
+    }
+
+    // A single timer tracks the earliest per-transaction deadline.
+    qint64 earliest = m_inFlight.constBegin()->deadlineMs;
+    for (const auto &transaction : m_inFlight) {
+        earliest = qMin(earliest, transaction.deadlineMs);
+    }
+    m_replyTimeout->start(int(qMax<qint64>(0, earliest - m_clock.elapsed())));
+}
+
+void ModbusClient::abortInFlight(const QString &reason)
+{
+    const auto inFlight = std::exchange(m_inFlight, {});
+    QList<Transaction> replayedWrites;
+    for (auto it = inFlight.constBegin(); it != inFlight.constEnd(); ++it) {
+        m_transport->cancel(it.key());
+
+        if (!it->transaction.isRead && m_retryWrites) {
+            // Replayed after reconnect, unless it expires first.
+            replayedWrites.append(it->transaction);
+            continue;
+        }
+
+        ModbusResult result;
+        result.status = ModbusResult::Aborted;
+        result.errorString = reason;
+        recordOutcome(it.value(), result);
+        updateRegisterImage(it->transaction, result);
+        completeTransaction(it->transaction, result);
+    }
+    // The hash has no order; requeue by write sequence so the newest values still win.
+    requeueWrites(replayedWrites);
+    rearmReplyTimeout();
 }
 
+void ModbusClient::abortQueuedReads(const QString &reason)
+{
+    // Polls are repeated after reconnect anyway, only operator writes are kept.
+    ModbusResult result;
+    result.status = ModbusResult::Aborted;
+    result.errorString = reason;
+
+    const auto capture = std::exchange(m_captureReads, {});
+    const auto planned = std::exchange(m_plannedReads, {});
+    const auto queued = std::exchange(m_readQueue, {});
+    for (const Transaction &transaction : capture) {
+        completeTransaction(transaction, result);
+    }
+    for (const Transaction &transaction : planned) {
+        completeTransaction(transaction, result);
+    }
+    for (const Transaction &transaction : queued) {
+        completeTransaction(transaction, result);
+    }
+    updateQueueGauges();
+}
+
+bool ModbusClient::dropIfExpired(const Transaction &transaction)
+{
+    if (transaction.expiresMs == 0 || m_clock.elapsed() < transaction.expiresMs) {
+        return false;
+    }
+
+    ModbusResult result;
+    result.status = ModbusResult::Aborted;
+    result.errorString = tr("Modbus write at 0x%1 expired before the connection was restored")
+                             .arg(transaction.startAddress, 0, 16);
+    handleError(result.errorString);
+    completeTransaction(transaction, result);
+    return true;
+}
@@ -2,6 +2,8 @@
 #pragma once
 
 #include <QObject>
+#include <QAtomicInt>
+#include <QElapsedTimer>
 #include <QHash>
 #include <QList>
 #include <QPointer>
@@ -9,20 +11,28 @@
 #include <QVector>
 #include <QTimer>
 
-class QModbusReply;
-class QModbusTcpClient;
+#include "modbusmetrics.h"
+#include "modbusresult.h"
+#include "pollscheduler.h"
+#include "registerimage.h"
+#include "subscriptionrouter.h"
+
 class ModbusClient;
+class ModbusTransport;
 
 class ModbusBase
 {
 public:
     virtual void setModbusClient(ModbusClient *client) = 0;
 
-    virtual void requestAllValues() const = 0;
+    virtual void requestAllValues() = 0;
+
+    // Register groups polled for this consumer while it is shown.
+    virtual QVector<PollGroup> pollGroups() const = 0;
 };
 
 /**
- * @brief Qt wrapper around QModbusTcpClient that exposes a high-level API for Modbus TCP communication.
+ * @brief High-level API for Modbus TCP communication on top of a selectable transport.
  */
 class ModbusClient : public QObject
 {
@@ -30,16 +40,166 @@ class ModbusClient : public QObject
     Q_DISABLE_COPY(ModbusClient)
 
 public:
+    // Acknowledge trusts the FC16 acknowledgement: the written values go to the register
+    // image and subscribers as soon as the device accepts them. ReadBack also reads the
+    // range back and completes with the values the device reports.
+    enum class WriteConfirmation
+    {
+        Acknowledge,
+        ReadBack,
+    };
+
+    // AllowCached lets a read be answered from the register image (see
+    // setCacheMaxAgeMs()), Device always sends it. Capture sends it as a request of its
+    // own that only completes its caller: it is never merged with other reads, does not
+    // count against setMaxQueuedReads(), is not retried and bypasses the register image
+    // and subscriptions.
+    enum class ReadSource
+    {
+        AllowCached,
+        Device,
+        Capture,
+    };
+
+    enum class Engine
+    {
+        QtSerialBus, // QModbusTcpClient
+        Native,      // Own MBAP framing on a raw QTcpSocket
+    };
+
     explicit ModbusClient(QObject *parent = nullptr);
     ~ModbusClient() override;
 
+    // Switches the transport. Outstanding requests are aborted and an open connection
+    // is re-established with the new engine.
+    void setEngine(Engine engine);
+    Engine engine() const;
+
     void setConnectionParameters(const QString &host, quint16 port, int timeoutMs = 1000);
     void setConnectTimeoutMs(int timeoutMs);
 
+    // Reply timeouts follow the measured round-trip time (smoothed RTT plus four times
+    // its mean deviation) within these bounds. Until the first reply on a connection
+    // the timeout passed to setConnectionParameters() is used.
+    void setReplyTimeoutBounds(int minMs, int maxMs);
+    int replyTimeoutMs() const;
+    // Smoothed round-trip time of the current connection, -1 before the first reply.
+    int roundTripTimeUs() const;
+
+    // Failed reads are sent again after a jittered backoff (baseBackoffMs doubled per
+    // attempt) while they can still finish within cycleDeadlineMs of being enqueued.
+    // Exception responses and aborted requests are never retried.
+    void setReadRetryPolicy(int maxRetries, int baseBackoffMs, int cycleDeadlineMs);
+    // Writes are not idempotent in general, so they are only retried when enabled.
+    void setRetryWrites(bool enabled);
+
+    // Reads one register whenever the link has been silent for intervalMs. After
+    // maxMisses consecutive misses the connection is dropped. Requests that time out
+    // together count as one miss, so a stall expiring a full pipeline is not several.
+    // An interval of 0 disables the heartbeat.
+    void setHeartbeat(int intervalMs, int maxMisses = 2, int address = 0x100);
+
+    // Writes queued while the link is down are kept for this long and sent once it is
+    // back. 0 keeps them until sent.
+    void setWriteExpiryMs(int expiryMs);
+
+    // Time from the last (re)connect to the first successful read, -1 before that.
+    // Safe to read from any thread.
+    int timeToFirstDataMs() const;
+
+    // Latency histograms and counters, safe to read from any thread.
+    const ModbusMetrics &metrics() const;
+    ModbusMetrics::Snapshot metricsSnapshot() const;
+
+    // Number of transactions allowed to be outstanding on the connection at once.
+    // 1 keeps the strict request/response behaviour, larger values pipeline requests.
+    void setMaxInFlightRequests(int count);
+    int maxInFlightRequests() const;
+
+    // Delay between the first enqueued message and dispatch, letting callers coalesce
+    // several requests into one batch. 0 dispatches on the next event loop iteration.
+    void setDispatchBatchingWindowUs(int windowUs);
+    int dispatchBatchingWindowUs() const;
+
+    // How long the oldest queued write waits for writes to adjacent registers, which
+    // are combined with it into a single FC16 request. 0 sends writes immediately.
+    void setWriteCombiningWindowUs(int windowUs);
+    int writeCombiningWindowUs() const;
+
+    // Largest hole (in registers) that may be read and discarded to merge two queued
+    // reads into a single request.
+    void setReadGapFillThreshold(int registers);
+    int readGapFillThreshold() const;
+
+    // Sends a write and the planned read right behind it as one FC23 request while the
+    // device accepts FC23. Off by default.
+    void setReadWriteFusion(bool enabled);
+    bool readWriteFusion() const;
+
+    // Unsent reads kept at most; the oldest one is dropped to make room for a new one.
+    // 0 leaves the queue unbounded.
+    void setMaxQueuedReads(int count);
+    int maxQueuedReads() const;
+
+    // Latest known state of the device registers, safe to read from any thread.
+    const RegisterImage &registerImage() const;
+
+    // Reads whose whole range was updated in the register image within this age, and
+    // after the last acknowledged write, are answered from the image without a request.
+    // 0 disables the cache.
+    void setCacheMaxAgeMs(int maxAgeMs);
+    int cacheMaxAgeMs() const;
+
     bool isConnected() const;
 
     void readHoldingRegisters(int startAddress, quint16 numberOfEntries, int serverAddress = 1);
 
+    // Request variants with a completion callback. The callback runs in the thread of
+    // context, only for this request, and is dropped if context is destroyed first.
+    void readHoldingRegisters(int startAddress,
+                              quint16 numberOfEntries,
+                              QObject *context,
+                              ModbusCallback callback,
+                              int serverAddress = 1,
+                              ReadSource source = ReadSource::AllowCached);
+    void writeMultipleRegisters(int startAddress,
+                                const QVector<quint16> &values,
+                                QObject *context,
+                                ModbusCallback callback,
+                                int serverAddress = 1,
+                                WriteConfirmation confirmation = WriteConfirmation::Acknowledge);
+
+    // Writes values, then reads the read range in one Read/Write Multiple Registers
+    // (FC23) request; callback gets the read range. Sent as a write followed by a read
+    // once the device has rejected FC23 as an illegal function.
+    void readWriteMultipleRegisters(int writeStartAddress,
+                                    const QVector<quint16> &values,
+                                    int readStartAddress,
+                                    quint16 readNumberOfEntries,
+                                    QObject *context,
+                                    ModbusCallback callback,
+                                    int serverAddress = 1);
+
+    // Calls callback with every successful read or acknowledged write overlapping the
+    // range, clipped to it, with a mask of the registers that changed. ChangesOnly skips
+    // updates that change nothing in the range.
+    // Complete register image contents for the range are delivered right away; otherwise
+    // each register is first delivered, marked changed, with the first reply covering it.
+    int subscribe(int startAddress,
+                  quint16 numberOfEntries,
+                  QObject *context,
+                  ModbusCallback callback,
+                  int serverAddress = 1,
+                  SubscriptionRouter::Delivery delivery = SubscriptionRouter::EveryUpdate);
+    void unsubscribe(int subscriptionId);
+    void unsubscribe(QObject *context);
+
+    // Withdraws owner from its unsent and in-flight reads; owner is only compared, never
+    // dereferenced. Reads nobody else waits for are dropped before dispatch, and their
+    // late replies only update the register image. Reads of a destroyed owner are
+    // treated the same way.
+    void cancelRequests(QObject *owner);
+
 public slots:
     bool connectDevice(const QString &host, quint16 port);
     void disconnectDevice();
@@ -49,53 +209,186 @@ public slots:
 
 signals:
     void connectionStateChanged(bool connected);
+    // Emitted at most twice a second while the estimate changes.
+    void roundTripTimeChanged(int smoothedRttUs, int rttVariationUs, int replyTimeoutMs);
+    void firstDataAfterConnect(int timeToFirstDataMs);
     void errorOccurred(const QString &message);
 
     void readCompleted(int startAddress, const QVector<quint16> &values);
     void writeCompleted(int startAddress, quint16 numberOfEntries);
 
 private:
-    void recreateClient();
-    void handleReplyFinished(QModbusReply *reply, bool isReadOperation);
-    void handleError(const QString &context, QModbusReply *reply = nullptr);
-
-    void enqueueMessage(int address,
-                        quint16 numberOfEntries,
-                        const QVector<quint16> &values,
-                        int serverAddress,
-                        bool isRead);
-    void dispatchQueuedMessages();
-    void sendNextQueuedMessage();
-    QModbusReply *sendReadRequest(int startAddress, quint16 numberOfEntries, int serverAddress);
-    QModbusReply *sendWriteRequest(int startAddress, const QVector<quint16> &values, int serverAddress);
-    void startDispatchTimerIfNeeded();
-    void stopDispatching();
-    void onReplySettled();
-    void startReplyTimeout();
+    struct Completion
+    {
+        QPointer<QObject> context;
+        ModbusCallback callback;
+        // The request was made on behalf of context and lapses once it is gone or cancelled.
+        bool owned = false;
+    };
+
+    // The range one caller asked for, together with the callers waiting on it.
+    struct RequestPart
+    {
+        int startAddress = 0;
+        quint16 numberOfEntries = 0;
+        QVector<Completion> completions;
+    };
 
-    struct QueuedMessage
+    // A single Modbus request as it goes on the wire.
+    struct Transaction
     {
         bool isRead = true;
+        int startAddress = 0;
         quint16 numberOfEntries = 0;
         QVector<quint16> values;
         int serverAddress = 1;
+        qint64 enqueuedNs = 0;
+        int attempt = 0;
+        bool isHeartbeat = false;
+        // Sent for ReadSource::Capture.
+        bool isCapture = false;
+        // Writes only: dropped if still unsent at this time, 0 never expires.
+        qint64 expiresMs = 0;
+        // Writes only: when its newest values were queued. Where writes overlap, the
+        // values of the higher sequence win.
+        quint64 writeSequence = 0;
+        // Original requests served by this transaction.
+        QVector<RequestPart> parts;
+        // FC23 only: the fields above describe the write, these the read done after it.
+        bool isReadWrite = false;
+        // Set when the read was a queued poll fused onto the write; both halves then keep
+        // the retry policy they would have had as separate requests.
+        bool isFused = false;
+        int readStartAddress = 0;
+        quint16 readNumberOfEntries = 0;
+        QVector<RequestPart> readParts;
     };
 
+    struct InFlightTransaction
+    {
+        Transaction transaction;
+        qint64 sentNs = 0;
+        qint64 deadlineMs = 0;
+    };
+
+    void createTransport();
+    void handleTransportFinished(quint16 transactionId, const ModbusResult &result);
+    void handleReplyFinished(const Transaction &transaction, ModbusResult result);
+    bool retryTransaction(const Transaction &transaction, const ModbusResult &result);
+    void handleError(const QString &context);
+    void completeTransaction(const Transaction &transaction, const ModbusResult &result);
+    void completeParts(const QVector<RequestPart> &parts, bool isRead, const ModbusResult &result);
+    void updateRegisterImage(const Transaction &transaction,
+                             const ModbusResult &result,
+                             QBitArray *writeChanged = nullptr,
+                             QBitArray *readChanged = nullptr);
+    void routeToSubscribers(const Transaction &transaction,
+                            const ModbusResult &result,
+                            const QBitArray &writeChanged,
+                            const QBitArray &readChanged);
+    bool completeFromRegisterImage(int startAddress,
+                                   quint16 numberOfEntries,
+                                   int serverAddress,
+                                   const Completion &completion);
+
+    void enqueueRead(int startAddress, quint16 numberOfEntries, int serverAddress, const Completion &completion);
+    void enqueueWrite(int startAddress, const QVector<quint16> &values, int serverAddress, const Completion &completion);
+    void enqueueWriteThenRead(int writeStartAddress,
+                              const QVector<quint16> &values,
+                              int readStartAddress,
+                              quint16 readNumberOfEntries,
+                              int serverAddress,
+                              const Completion &completion);
+    void fuseWithNextRead(Transaction &write);
+    bool fallBackFromReadWrite(const Transaction &transaction, const ModbusResult &result);
+    static void splitReadWrite(const Transaction &transaction, Transaction *write, Transaction *read);
+    void dispatchQueuedMessages();
+    void planQueuedReads();
+    void sendNextQueuedMessage();
+    bool sendTransaction(const Transaction &transaction);
+    void sendHeartbeat();
+    void registerMiss();
+    void scheduleDispatch();
+    void stopDispatching();
+    void onReplySettled(quint16 transactionId);
+    void handleReplyTimeouts();
+    void rearmReplyTimeout();
+    void abortInFlight(const QString &reason);
+    void abortQueuedReads(const QString &reason);
+    bool dropIfExpired(const Transaction &transaction);
+    static bool isWanted(const Transaction &transaction);
+    void dropUnwantedReads(QList<Transaction> &queue);
+    bool combineWrite(int startAddress, const QVector<quint16> &values, int serverAddress, const RequestPart &part);
+    void requeueWrites(QList<Transaction> writes);
+    bool absorbIntoNewerWrites(Transaction &write);
+    bool isWriteDue() const;
+    void recordOutcome(const InFlightTransaction &inFlight, const ModbusResult &result);
+    void updateQueueGauges();
+    void dropOldestQueuedRead();
+    void resetRoundTripEstimate();
+    void addRoundTripSample(qint64 sampleUs);
+    void backOffReplyTimeout();
+
     QString m_host;
     quint16 m_port = 502;
     int m_timeoutMs = 1000;
 
-    QPointer<QModbusTcpClient> m_client;
+    Engine m_engine = Engine::QtSerialBus;
+    ModbusTransport *m_transport = nullptr;
 
-    QHash<int, QueuedMessage> m_messageQueue;
-    QList<int> m_messageOrder;
-    QList<int> m_pendingDispatch;
-    bool m_isDispatching = false;
+    // Operator writes always go out before poll reads; each class is served FIFO.
+    QList<Transaction> m_writeQueue;
+    QList<Transaction> m_readQueue;
+    QList<Transaction> m_plannedReads;
+    QList<Transaction> m_captureReads;
+    int m_maxQueuedReads = 64;
+    bool m_readWriteFusion = false;
+    // Cleared when the device answers FC23 with an illegal function exception.
+    bool m_readWriteSupported = true;
+    int m_gapFillThreshold = 4;
+    RegisterImage m_registerImage;
+    SubscriptionRouter m_subscriptions;
+    int m_cacheMaxAgeMs = 0;
+    qint64 m_lastWriteAckMs = 0;
     QTimer *m_dispatchTimer = nullptr;
+    int m_batchingWindowUs = 0;
+    int m_writeCombiningWindowUs = 0;
     QTimer *m_replyTimeout = nullptr;
     QTimer *m_connectTimeoutTimer = nullptr;
-    QPointer<QModbusReply> m_activeReply;
+
+    QHash<quint16, InFlightTransaction> m_inFlight;
+    quint16 m_nextTransactionId = 0;
+    quint64 m_writeSequence = 0;
+    int m_maxInFlight = 1;
+    QElapsedTimer m_clock;
 
     int m_connectTimeoutMs = 2000;
+
+    // Jacobson/Karels round-trip estimator, see addRoundTripSample().
+    int m_minReplyTimeoutMs = 50;
+    int m_maxReplyTimeoutMs = 3000;
+    qint64 m_smoothedRttUs = -1;
+    qint64 m_rttVariationUs = 0;
+    int m_replyTimeoutMs = 1000;
+    qint64 m_lastRttReportMs = 0;
+
+    int m_maxRetries = 2;
+    int m_retryBackoffMs = 10;
+    int m_retryCycleDeadlineMs = 500;
+    bool m_retryWrites = false;
+    QTimer *m_heartbeatTimer = nullptr;
+    int m_heartbeatAddress = 0x100;
+    int m_maxHeartbeatMisses = 2;
+    int m_heartbeatMisses = 0;
+    // When the last miss was counted; requests sent before it add no further miss.
+    qint64 m_lastMissNs = 0;
+    qint64 m_lastReplyMs = 0;
+
+    int m_writeExpiryMs = 10000;
+    qint64 m_connectedAtMs = 0;
+    bool m_awaitingFirstData = false;
+    QAtomicInt m_timeToFirstDataMs{-1};
+
+    ModbusMetrics m_metrics;
 };
 
@@ -0,0 +1,131 @@
+#include "modbusmetrics.h"
+
+#include <cmath>
+
+int LatencyHistogram::bucketIndex(qint64 valueUs)
+{
+    if (valueUs < kSubBuckets) {
+        return int(qMax<qint64>(0, valueUs));
+    }
+
+    int msb = 0;
+    for (quint64 v = quint64(valueUs); v > 1; v >>= 1) {
+        ++msb;
+    }
+    const int shift = msb - 3;
+    const int subBucket = int((quint64(valueUs) >> shift) & (kSubBuckets - 1));
+    return qMin((msb - 2) * kSubBuckets + subBucket, kBucketCount - 1);
+}
+
+qint64 LatencyHistogram::bucketUpperBoundUs(int index)
+{
+    if (index < kSubBuckets) {
+        return index + 1;
+    }
+
+    const int msb = index / kSubBuckets + 2;
+    const int subBucket = index % kSubBuckets;
+    const qint64 width = qint64(1) << (msb - 3);
+    return (kSubBuckets + subBucket) * width + width;
+}
+
+void LatencyHistogram::record(qint64 valueUs)
+{
+    valueUs = qMax<qint64>(0, valueUs);
+    m_counts[bucketIndex(valueUs)].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    m_sumUs.fetch_add(quint64(valueUs), std::memory_order_relaxed);
+
+    // Single writer, so a plain compare is enough to keep the maximum.
+    if (quint64(valueUs) > m_maxUs.load(std::memory_order_relaxed)) {
+        m_maxUs.store(quint64(valueUs), std::memory_order_relaxed);
+    }
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::snapshot() const
+{
+    Snapshot snapshot;
+    snapshot.counts.resize(kBucketCount);
+    for (int i = 0; i < kBucketCount; ++i) {
+        snapshot.counts[i] = m_counts[i].load(std::memory_order_relaxed);
+        snapshot.count += snapshot.counts[i];
+    }
+    snapshot.sumUs = m_sumUs.load(std::memory_order_relaxed);
+    snapshot.maxUs = m_maxUs.load(std::memory_order_relaxed);
+    return snapshot;
+}
+
+qint64 LatencyHistogram::Snapshot::percentileUs(double percentile) const
+{
+    if (count == 0) {
+        return 0;
+    }
+
+    const quint64 rank = qMax<quint64>(1, quint64(std::ceil(qBound(0.0, percentile, 100.0) / 100.0 * double(count))));
+    quint64 seen = 0;
+    for (int i = 0; i < counts.size(); ++i) {
+        seen += counts.at(i);
+        if (seen >= rank) {
+            return qMin<qint64>(bucketUpperBoundUs(i), qint64(maxUs));
+        }
+    }
+    return qint64(maxUs);
+}
+
+int ModbusMetrics::addressPage(int startAddress)
+{
+    return qBound(0, startAddress / kAddressPageSize, kAddressPages - 1);
+}
+
+void ModbusMetrics::recordLatency(FunctionCode functionCode, int startAddress, qint64 queueWaitUs, qint64 wireUs)
+{
+    LatencySet &set = m_latencies[functionCode * kAddressPages + addressPage(startAddress)];
+    set.queueWait.record(queueWaitUs);
+    set.wire.record(wireUs);
+    set.total.record(queueWaitUs + wireUs);
+}
+
+void ModbusMetrics::increment(Counter counter, quint64 amount)
+{
+    m_counters[counter].fetch_add(amount, std::memory_order_relaxed);
+}
+
+quint64 ModbusMetrics::counter(Counter counter) const
+{
+    return m_counters[counter].load(std::memory_order_relaxed);
+}
+
+void ModbusMetrics::setGauge(Gauge gauge, int value)
+{
+    m_gauges[gauge].store(value, std::memory_order_relaxed);
+    if (value > m_gaugePeaks[gauge].load(std::memory_order_relaxed)) {
+        m_gaugePeaks[gauge].store(value, std::memory_order_relaxed);
+    }
+}
+
+ModbusMetrics::Snapshot ModbusMetrics::snapshot() const
+{
+    Snapshot snapshot;
+    for (int i = 0; i < int(m_latencies.size()); ++i) {
+        const LatencySet &set = m_latencies[i];
+        Snapshot::Latency latency;
+        latency.total = set.total.snapshot();
+        if (latency.total.count == 0) {
+            continue;
+        }
+        latency.functionCode = FunctionCode(i / kAddressPages);
+        latency.addressPage = i % kAddressPages;
+        latency.queueWait = set.queueWait.snapshot();
+        latency.wire = set.wire.snapshot();
+        snapshot.latencies.append(latency);
+    }
+
+    for (int i = 0; i < CounterCount; ++i) {
+        snapshot.counters[i] = m_counters[i].load(std::memory_order_relaxed);
+    }
+    for (int i = 0; i < GaugeCount; ++i) {
+        snapshot.gauges[i] = m_gauges[i].load(std::memory_order_relaxed);
+        snapshot.gaugePeaks[i] = m_gaugePeaks[i].load(std::memory_order_relaxed);
+    }
+    return snapshot;
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <QVector>
+#include <QtGlobal>
+
+#include <array>
+#include <atomic>
+
+/**
+ * @brief Lock-free latency histogram with logarithmic buckets.
+ *
+ * Every power of two is split into eight linear sub-buckets (HDR style), so a recorded
+ * value is known within 12.5% from 1 us up to 2^25 us (about 33 s); longer values land in
+ * the last bucket. Recording is a few relaxed atomic increments; snapshots never block
+ * the recording thread.
+ */
+class LatencyHistogram
+{
+public:
+    static constexpr int kSubBuckets = 8;
+    // Eight sub-buckets for each power of two from 2^3 to 2^24, after the eight 1 us ones.
+    static constexpr int kBucketCount = 184;
+
+    struct Snapshot
+    {
+        QVector<quint64> counts;
+        quint64 count = 0;
+        quint64 sumUs = 0;
+        quint64 maxUs = 0;
+
+        // Upper bound of the bucket holding the given percentile (0..100), 0 when empty.
+        qint64 percentileUs(double percentile) const;
+        qint64 meanUs() const { return count ? qint64(sumUs / count) : 0; }
+    };
+
+    void record(qint64 valueUs);
+    Snapshot snapshot() const;
+
+    static int bucketIndex(qint64 valueUs);
+    static qint64 bucketUpperBoundUs(int index);
+
+private:
+    std::array<std::atomic<quint64>, kBucketCount> m_counts{};
+    std::atomic<quint64> m_count{0};
+    std::atomic<quint64> m_sumUs{0};
+    std::atomic<quint64> m_maxUs{0};
+};
+
+/**
+ * @brief Latency histograms and counters of the Modbus pipeline.
+ *
+ * Written by ModbusClient in the Modbus thread, readable from any thread through
+ * snapshot().
+ */
+class ModbusMetrics
+{
+public:
+    enum FunctionCode
+    {
+        ReadHoldingRegisters,   // 0x03
+        WriteMultipleRegisters, // 0x10
+        ReadWriteRegisters,     // 0x17
+        FunctionCodeCount,
+    };
+
+    // Histograms are kept per 0x100 register page; the last page collects the rest.
+    static constexpr int kAddressPageSize = 0x100;
+    static constexpr int kAddressPages = 8;
+
+    enum Counter
+    {
+        Sent,
+        Answered,
+        Timeouts,
+        ProtocolExceptions,
+        Aborted,
+        Errors,
+        Retries,
+        FailedAfterRetries,
+        ServedFromCache,
+        DroppedPolls,      // Unsent reads evicted from a full queue.
+        CoalescedReads,    // Reads served by an identical queued read or a planned read covering them.
+        CancelledReads,    // Reads dropped or ignored because every requester went away.
+        CounterCount,
+    };
+
+    enum Gauge
+    {
+        WriteQueueDepth,
+        ReadQueueDepth,
+        InFlight,
+        GaugeCount,
+    };
+
+    struct LatencySet
+    {
+        LatencyHistogram queueWait; // Enqueue to send.
+        LatencyHistogram wire;      // Send to answer.
+        LatencyHistogram total;     // Enqueue to answer.
+    };
+
+    struct Snapshot
+    {
+        struct Latency
+        {
+            FunctionCode functionCode = ReadHoldingRegisters;
+            int addressPage = 0;
+            LatencyHistogram::Snapshot queueWait;
+            LatencyHistogram::Snapshot wire;
+            LatencyHistogram::Snapshot total;
+        };
+
+        // Only the function code / page combinations that saw traffic.
+        QVector<Latency> latencies;
+        std::array<quint64, CounterCount> counters{};
+        std::array<int, GaugeCount> gauges{};
+        std::array<int, GaugeCount> gaugePeaks{};
+    };
+
+    void recordLatency(FunctionCode functionCode, int startAddress, qint64 queueWaitUs, qint64 wireUs);
+    void increment(Counter counter, quint64 amount = 1);
+    quint64 counter(Counter counter) const;
+    void setGauge(Gauge gauge, int value);
+
+    Snapshot snapshot() const;
+
+private:
+    static int addressPage(int startAddress);
+
+    std::array<LatencySet, FunctionCodeCount * kAddressPages> m_latencies;
+    std::array<std::atomic<quint64>, CounterCount> m_counters{};
+    std::array<std::atomic<int>, GaugeCount> m_gauges{};
+    std::array<std::atomic<int>, GaugeCount> m_gaugePeaks{};
+};
@@ -0,0 +1,54 @@
+#include "modbusreadplanner.h"
+
+#include <algorithm>
+
+namespace ModbusReadPlanner {
+
+QVector<PlannedRead> plan(const QVector<ReadRange> &ranges, int gapFillThreshold, quint16 maxRegisters)
+{
+    QVector<int> order(ranges.size());
+    for (int i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&ranges](int lhs, int rhs) {
+        const ReadRange &a = ranges.at(lhs);
+        const ReadRange &b = ranges.at(rhs);
+        if (a.serverAddress != b.serverAddress) {
+            return a.serverAddress < b.serverAddress;
+        }
+        return a.startAddress < b.startAddress;
+    });
+
+    QVector<PlannedRead> planned;
+    int currentEnd = 0;
+
+    for (const int index : order) {
+        const ReadRange &range = ranges.at(index);
+        const int rangeEnd = range.startAddress + range.numberOfEntries;
+
+        if (!planned.isEmpty()) {
+            PlannedRead &current = planned.last();
+            const int mergedEnd = qMax(currentEnd, rangeEnd);
+            if (current.serverAddress == range.serverAddress
+                && range.startAddress <= currentEnd + gapFillThreshold
+                && mergedEnd - current.startAddress <= maxRegisters) {
+                currentEnd = mergedEnd;
+                current.numberOfEntries = quint16(currentEnd - current.startAddress);
+                current.sources.append(index);
+                continue;
+            }
+        }
+
+        PlannedRead read;
+        read.serverAddress = range.serverAddress;
+        read.startAddress = range.startAddress;
+        read.numberOfEntries = range.numberOfEntries;
+        read.sources.append(index);
+        planned.append(read);
+        currentEnd = rangeEnd;
+    }
+
+    return planned;
+}
+
+} // namespace ModbusReadPlanner
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <QVector>
+#include <QtGlobal>
+
+/**
+ * @brief Merges holding register reads into the fewest Modbus PDUs.
+ *
+ * Reads addressed to the same server are sorted by start address and merged while the
+ * hole between them does not exceed the gap-fill threshold and the merged range still
+ * fits into a single Read Holding Registers request.
+ */
+namespace ModbusReadPlanner {
+
+// Protocol limit for function code 0x03.
+constexpr quint16 kMaxReadRegisters = 125;
+
+struct ReadRange
+{
+    int serverAddress = 1;
+    int startAddress = 0;
+    quint16 numberOfEntries = 0;
+};
+
+struct PlannedRead
+{
+    int serverAddress = 1;
+    int startAddress = 0;
+    quint16 numberOfEntries = 0;
+    // Indexes into the input ranges served by this request.
+    QVector<int> sources;
+};
+
+QVector<PlannedRead> plan(const QVector<ReadRange> &ranges,
+                          int gapFillThreshold,
+                          quint16 maxRegisters = kMaxReadRegisters);
+
+} // namespace ModbusReadPlanner
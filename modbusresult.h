@@ -0,0 +1,60 @@
+#pragma once
+
+#include <QBitArray>
+#include <QString>
+#include <QVector>
+#include <QtGlobal>
+
+#include <chrono>
+#include <functional>
+
+#include "registerslice.h"
+
+/**
+ * @brief Outcome of a single read or write request, delivered to the requester only.
+ */
+struct ModbusResult
+{
+    enum Status
+    {
+        Ok,
+        ProtocolError,  // The device answered with a Modbus exception.
+        Timeout,
+        Aborted,        // The connection was closed while the request was outstanding.
+        Error,
+    };
+
+    Status status = Ok;
+    int startAddress = 0;
+    quint16 numberOfEntries = 0;
+    RegisterSlice values;
+    int exceptionCode = 0;
+    QString errorString;
+    // Subscription updates only: bit i is set if values[i] differs from what the register
+    // image held before. Empty means every value may have changed.
+    QBitArray changed;
+    // Monotonic time the reply was received (see monotonicUs()), 0 when answered
+    // without a request.
+    qint64 receivedUs = 0;
+
+    static qint64 monotonicUs()
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    bool isOk() const { return status == Ok; }
+    bool isChanged(int index) const { return changed.isEmpty() || changed.testBit(index); }
+    bool isChanged(int index, int count) const
+    {
+        for (int i = index; i < index + count; ++i) {
+            if (isChanged(i)) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+using ModbusCallback = std::function<void(const ModbusResult &result)>;
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <QObject>
+#include <QString>
+#include <QVector>
+
+#include "modbusresult.h"
+
+/**
+ * @brief Connection to a Modbus TCP server that carries ModbusClient's transactions.
+ *
+ * Requests are identified by the transaction id chosen by the caller. Each request that
+ * was sent successfully ends with exactly one finished() signal unless it is cancelled.
+ */
+class ModbusTransport : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum State
+    {
+        Unconnected,
+        Connecting,
+        Connected,
+    };
+
+    using QObject::QObject;
+
+    virtual void setConnectionParameters(const QString &host, quint16 port, int timeoutMs) = 0;
+    virtual bool connectDevice() = 0;
+    virtual void disconnectDevice() = 0;
+    // Drops the connection at once, including a connection attempt in progress.
+    virtual void abort() = 0;
+
+    virtual State state() const = 0;
+    virtual QString errorString() const = 0;
+
+    virtual bool sendReadRequest(quint16 transactionId, int startAddress, quint16 numberOfEntries, int serverAddress) = 0;
+    virtual bool sendWriteRequest(quint16 transactionId,
+                                  int startAddress,
+                                  const QVector<quint16> &values,
+                                  int serverAddress) = 0;
+    // Read/Write Multiple Registers (FC23): the device applies values first, then reads
+    // the read range. The result describes the read range.
+    virtual bool sendReadWriteRequest(quint16 transactionId,
+                                      int readStartAddress,
+                                      quint16 readNumberOfEntries,
+                                      int writeStartAddress,
+                                      const QVector<quint16> &values,
+                                      int serverAddress) = 0;
+    // Forgets the request; a late answer to it is discarded.
+    virtual void cancel(quint16 transactionId) = 0;
+
+signals:
+    void stateChanged(ModbusTransport::State state);
+    void errorOccurred(const QString &message);
+    void finished(quint16 transactionId, const ModbusResult &result);
+};
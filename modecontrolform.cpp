@@ -66,37 +66,53 @@ void ModeControlForm::setModbusClient(ModbusClient *client)
     }
 
     if (m_modbusClient) {
-        disconnect(m_modbusClient, &ModbusClient::readCompleted,
-                   this, &ModeControlForm::handleReadCompleted);
-        disconnect(m_modbusClient, &ModbusClient::writeCompleted,
-                   this, &ModeControlForm::handleWriteCompleted);
+        QMetaObject::invokeMethod(m_modbusClient,
+                                  [oldClient = m_modbusClient, form = static_cast<QObject *>(this)]() {
+                                      oldClient->unsubscribe(form);
+                                  },
+                                  Qt::QueuedConnection);
     }
-
     m_modbusClient = client;
-
-    if (m_modbusClient) {
-        connect(m_modbusClient, &ModbusClient::readCompleted,
-                this, &ModeControlForm::handleReadCompleted);
-        connect(m_modbusClient, &ModbusClient::writeCompleted,
-                this, &ModeControlForm::handleWriteCompleted);
-        // requestAllValues();
+    if (!m_modbusClient) {
+        return;
     }
+
+    // Every read covering the form's registers is routed here, whoever requested it.
+    QMetaObject::invokeMethod(m_modbusClient,
+                              [client = m_modbusClient, form = QPointer<ModeControlForm>(this)]() {
+                                  if (!client || !form) {
+                                      return;
+                                  }
+                                  const auto onRead = [form](const ModbusResult &result) {
+                                      form->handleReadCompleted(result);
+                                  };
+                                  client->subscribe(SensorsTableAddress::BoardOperatingMode,
+                                                    SensorsTableAddress::CaseTemperature_1 - SensorsTableAddress::BoardOperatingMode,
+                                                    form,
+                                                    onRead,
+                                                    1,
+                                                    SubscriptionRouter::ChangesOnly);
+                              },
+                              Qt::QueuedConnection);
 }
 
-void ModeControlForm::handleWriteCompleted(int startAddress, quint16 numberOfEntries)
+void ModeControlForm::handleWriteCompleted(const ModbusResult &result)
 {
-    Q_UNUSED(numberOfEntries);
-    // Check if this write was for one of our addresses
-    if (startAddress >= ModeAddress::ManualAddress &&
-        startAddress <= ModeAddress::WorkAddress)
-    {
-        // Refresh all values after a successful write
-        requestAllValues();
+    // The board and laser mode the device switched to arrive with the regular poll.
+    if (!result.isOk()) {
+        qWarning() << "Mode write to" << result.startAddress << "failed:" << result.errorString;
     }
 }
 
-void ModeControlForm::handleReadCompleted(int startAddress, const QVector<quint16> &values)
+void ModeControlForm::handleReadCompleted(const ModbusResult &result)
 {
+    if (!result.isOk()) {
+        return;
+    }
+
+    const int startAddress = result.startAddress;
+    const RegisterSlice &values = result.values;
+
     if (startAddress == SensorsTableAddress::BoardOperatingMode) //test ModeAddress::ManualAddress
     {
         qDebug() << "Received" << values.size() << "registers starting from" << startAddress;
@@ -108,7 +124,11 @@ void ModeControlForm::handleReadCompleted(int startAddress, const QVector<quint1
             value = toBigEndian(values[valueIndex]);
             // qDebug() << "value" << value;
 
-            if (currentAddress == SensorsTableAddress::BoardOperatingMode)
+            if (!result.isChanged(valueIndex))
+            {
+                // Mode unchanged, leave the radio buttons alone.
+            }
+            else if (currentAddress == SensorsTableAddress::BoardOperatingMode)
             {
                 switch (value) {
                 case Mode::Manual:
@@ -150,13 +170,17 @@ void ModeControlForm::sendState(int address, bool value)
     }
 
     QMetaObject::invokeMethod(m_modbusClient,
-                              [client = m_modbusClient, address, value]() {
-                                  if (!client) {
+                              [client = m_modbusClient, form = QPointer<ModeControlForm>(this), address, value]() {
+                                  if (!client || !form) {
                                       return;
                                   }
-                                  client->writeSingleRegister(address,
-                                                              value ? toLittleEndian(quint16(States::On)) :
-                                                                  toLittleEndian(quint16(States::Off)));
+                                  client->writeMultipleRegisters(address,
+                                                                 {value ? toLittleEndian(quint16(States::On)) :
+                                                                      toLittleEndian(quint16(States::Off))},
+                                                                 form,
+                                                                 [form](const ModbusResult &result) {
+                                                                     form->handleWriteCompleted(result);
+                                                                 });
                               },
                               Qt::QueuedConnection);
 }
@@ -183,16 +207,19 @@ void ModeControlForm::sendState(const QMap<int, bool> &states)
     }
 
     QMetaObject::invokeMethod(m_modbusClient,
-                              [client = m_modbusClient, startAddress, values]() {
-                                  if (!client) {
+                              [client = m_modbusClient, form = QPointer<ModeControlForm>(this), startAddress, values]() {
+                                  if (!client || !form) {
                                       return;
                                   }
-                                  client->writeMultipleRegisters(startAddress, values);
+                                  client->writeMultipleRegisters(startAddress, values, form,
+                                                                 [form](const ModbusResult &result) {
+                                                                     form->handleWriteCompleted(result);
+                                                                 });
                               },
                               Qt::QueuedConnection);
 }
 
-void ModeControlForm::requestAllValues() const
+void ModeControlForm::requestAllValues()
 {
     if (!m_modbusClient) {
         return;
@@ -207,15 +234,25 @@ void ModeControlForm::requestAllValues() const
     // const int registerCount = 1;
 
     QMetaObject::invokeMethod(m_modbusClient,
-                              [client = m_modbusClient, startAddress, registerCount]() {
-                                  if (!client) {
+                              [client = m_modbusClient, form = QPointer<ModeControlForm>(this), startAddress, registerCount]() {
+                                  if (!client || !form) {
                                       return;
                                   }
-                                  client->readHoldingRegisters(startAddress, registerCount);
+                                  client->readHoldingRegisters(startAddress, registerCount, form, {});
                               },
                               Qt::QueuedConnection);
 }
 
+QVector<PollGroup> ModeControlForm::pollGroups() const
+{
+    // The device switches modes on its own, keep the indicators responsive.
+    return {
+        {SensorsTableAddress::BoardOperatingMode,
+         SensorsTableAddress::CaseTemperature_1 - SensorsTableAddress::BoardOperatingMode,
+         100},
+    };
+}
+
 void ModeControlForm::on_pushButton_clicked()
 {
     requestAllValues();
@@ -24,11 +24,12 @@ public:
     void setModbusClient(ModbusClient *client);
 
 private slots:
-    void handleReadCompleted(int startAddress, const QVector<quint16> &values);
-    void handleWriteCompleted(int startAddress, quint16 numberOfEntries);
+    void handleReadCompleted(const ModbusResult &result);
+    void handleWriteCompleted(const ModbusResult &result);
     void sendState(int address, bool value);
     void sendState(const QMap<int, bool> &states);
-    void requestAllValues() const;
+    void requestAllValues() override;
+    QVector<PollGroup> pollGroups() const override;
 
     void on_pushButton_clicked();
 
@@ -0,0 +1,408 @@
+#include "pollscheduler.h"
+#include "modbusclient.h"
+#include "modbusreadplanner.h"
+
+#include <QLoggingCategory>
+#include <QMap>
+#include <QTimer>
+
+#include <algorithm>
+
+namespace {
+QLoggingCategory lcPoll("modbus.poll");
+
+// Fastest period a group may be scaled down to.
+constexpr int kMinPeriodMs = 20;
+// Shift between period classes, so a fast group does not fire together with a slow one.
+constexpr int kClassOffsetMs = 7;
+constexpr qint64 kNsPerMs = 1000000;
+}
+
+PollScheduler::PollScheduler(ModbusClient *client, QObject *parent)
+    : QObject(parent)
+    , m_client(client)
+    , m_timer(new QTimer(this))
+{
+    m_clock.start();
+    m_timer->setSingleShot(true);
+    m_timer->setTimerType(Qt::PreciseTimer);
+    connect(m_timer, &QTimer::timeout, this, [this]() {
+        poll();
+    });
+}
+
+void PollScheduler::setGroups(QObject *owner, const QVector<PollGroup> &groups, bool enabled)
+{
+    bool changed = removeOwner(owner);
+    for (const PollGroup &group : groups) {
+        if (group.numberOfEntries == 0) {
+            continue;
+        }
+
+        // Another consumer polling the same range only takes a reference on it.
+        const quint64 key = readKey(group);
+        Registration *registration = nullptr;
+        for (Registration &existing : m_registrations) {
+            if (readKey(existing.group) == key) {
+                registration = &existing;
+                break;
+            }
+        }
+        if (!registration) {
+            m_registrations.append(Registration());
+            registration = &m_registrations.last();
+            registration->group = group;
+            changed = true;
+        }
+
+        const bool wasEnabled = registration->isEnabled();
+        const int wasPeriodMs = registration->group.periodMs;
+        registration->owners.append({owner, enabled, group.periodMs});
+        updateRegistration(*registration);
+        changed = changed || wasEnabled != registration->isEnabled() || wasPeriodMs != registration->group.periodMs;
+    }
+    if (changed) {
+        rebuild();
+    }
+}
+
+void PollScheduler::setOwnerEnabled(QObject *owner, bool enabled)
+{
+    bool changed = false;
+    for (Registration &registration : m_registrations) {
+        const bool wasEnabled = registration.isEnabled();
+        for (Owner &registered : registration.owners) {
+            if (registered.object == owner) {
+                registered.enabled = enabled;
+            }
+        }
+        changed = changed || wasEnabled != registration.isEnabled();
+    }
+    if (changed) {
+        rebuild();
+    }
+}
+
+void PollScheduler::setBasePeriodMs(int basePeriodMs)
+{
+    m_basePeriodMs = qMax(1, basePeriodMs);
+    restagger();
+}
+
+int PollScheduler::basePeriodMs() const
+{
+    return m_basePeriodMs;
+}
+
+bool PollScheduler::isRunning() const
+{
+    return m_running;
+}
+
+QVector<PollGroupStats> PollScheduler::stats() const
+{
+    QVector<PollGroupStats> stats;
+    stats.reserve(m_entries.size());
+    for (const Entry &entry : m_entries) {
+        stats.append(entry.stats);
+    }
+    return stats;
+}
+
+PollFramePtr PollScheduler::latestFrame(int periodMs) const
+{
+    return m_assembler.latestFrame(periodMs);
+}
+
+void PollScheduler::start()
+{
+    m_running = true;
+    restagger();
+}
+
+void PollScheduler::stop()
+{
+    m_running = false;
+    m_timer->stop();
+
+    // A pass interrupted here would mix reads from before and after the pause.
+    for (const quint64 cycle : std::as_const(m_passCycles)) {
+        m_assembler.dropCycle(cycle);
+    }
+    m_passCycles.clear();
+    for (Entry &entry : m_entries) {
+        entry.visitedInPass = false;
+    }
+}
+
+bool PollScheduler::Registration::isEnabled() const
+{
+    for (const Owner &owner : owners) {
+        if (owner.object && owner.enabled) {
+            return true;
+        }
+    }
+    return false;
+}
+
+quint64 PollScheduler::readKey(const PollGroup &group)
+{
+    return (quint64(quint8(group.serverAddress)) << 32) | (quint64(quint16(group.startAddress)) << 16)
+           | group.numberOfEntries;
+}
+
+bool PollScheduler::removeOwner(QObject *owner)
+{
+    bool changed = false;
+    for (int i = int(m_registrations.size()) - 1; i >= 0; --i) {
+        Registration &registration = m_registrations[i];
+        const bool wasEnabled = registration.isEnabled();
+        const int wasPeriodMs = registration.group.periodMs;
+        registration.owners.erase(std::remove_if(registration.owners.begin(), registration.owners.end(),
+                                                 [owner](const Owner &registered) {
+                                                     return !registered.object || (owner && registered.object == owner);
+                                                 }),
+                                  registration.owners.end());
+        if (registration.owners.isEmpty()) {
+            changed = changed || wasEnabled;
+            m_registrations.removeAt(i);
+            continue;
+        }
+        updateRegistration(registration);
+        changed = changed || wasEnabled != registration.isEnabled() || wasPeriodMs != registration.group.periodMs;
+    }
+    return changed;
+}
+
+void PollScheduler::updateRegistration(Registration &registration)
+{
+    // Shared by owners asking for different rates, the range is polled at the fastest.
+    int periodMs = registration.owners.first().periodMs;
+    for (const Owner &owner : std::as_const(registration.owners)) {
+        periodMs = qMin(periodMs, owner.periodMs);
+    }
+    registration.group.periodMs = periodMs;
+}
+
+void PollScheduler::rebuild()
+{
+    // Fastest period asking for each register, keyed by server and address.
+    QMap<quint32, int> periods;
+    for (const Registration &registration : std::as_const(m_registrations)) {
+        if (!registration.isEnabled()) {
+            continue;
+        }
+        const PollGroup &group = registration.group;
+        for (int address = group.startAddress; address < group.startAddress + group.numberOfEntries; ++address) {
+            const quint32 key = (quint32(quint8(group.serverAddress)) << 16) | quint16(address);
+            const auto it = periods.find(key);
+            if (it == periods.end()) {
+                periods.insert(key, group.periodMs);
+            } else {
+                *it = qMin(*it, group.periodMs);
+            }
+        }
+    }
+
+    // Runs of registers sharing a period are read together. A hole no group reads is
+    // bridged up to the client's gap fill threshold, as the read planner would.
+    const int maxHole = m_client->readGapFillThreshold();
+    QVector<PollGroup> groups;
+    for (auto it = periods.cbegin(); it != periods.cend(); ++it) {
+        const int serverAddress = int(it.key() >> 16);
+        const int address = int(it.key() & 0xFFFF);
+        if (!groups.isEmpty()) {
+            PollGroup &last = groups.last();
+            if (last.serverAddress == serverAddress && last.periodMs == it.value()
+                && address - (last.startAddress + last.numberOfEntries) <= maxHole
+                && address + 1 - last.startAddress <= ModbusReadPlanner::kMaxReadRegisters) {
+                last.numberOfEntries = quint16(address + 1 - last.startAddress);
+                continue;
+            }
+        }
+        groups.append({address, 1, it.value(), serverAddress});
+    }
+
+    QVector<Entry> entries;
+    entries.reserve(groups.size());
+    for (const PollGroup &group : std::as_const(groups)) {
+        Entry entry;
+        entry.group = group;
+        entry.stats.group = group;
+        for (const Entry &previous : std::as_const(m_entries)) {
+            if (readKey(previous.group) == readKey(group) && previous.group.periodMs == group.periodMs) {
+                entry.visitedInPass = previous.visitedInPass;
+                entry.stats = previous.stats;
+                break;
+            }
+        }
+        entries.append(entry);
+    }
+    m_entries = entries;
+    qCDebug(lcPoll) << "Polling" << m_entries.size() << "ranges for" << m_registrations.size() << "registered groups";
+    restagger();
+}
+
+void PollScheduler::restagger()
+{
+    // Groups of the same period are spread evenly across it.
+    QMap<int, QVector<Entry *>> classes;
+    for (Entry &entry : m_entries) {
+        entry.periodMs = qMax(kMinPeriodMs, int(qint64(entry.group.periodMs) * m_basePeriodMs / 1000));
+        classes[entry.periodMs].append(&entry);
+    }
+
+    const qint64 nowNs = m_clock.nsecsElapsed();
+    int classIndex = 0;
+    for (auto it = classes.cbegin(); it != classes.cend(); ++it, ++classIndex) {
+        const int periodMs = it.key();
+        const QVector<Entry *> &entries = it.value();
+        for (int i = 0; i < entries.size(); ++i) {
+            const int phaseMs = (i * periodMs / int(entries.size()) + classIndex * kClassOffsetMs) % periodMs;
+            entries.at(i)->nextDueNs = nowNs + phaseMs * kNsPerMs;
+        }
+    }
+    // A pass may have been waiting for a range that is no longer polled.
+    closePassesIfDone();
+    rearm();
+}
+
+void PollScheduler::rearm()
+{
+    if (!m_running) {
+        return;
+    }
+
+    qint64 earliestNs = -1;
+    for (const Entry &entry : std::as_const(m_entries)) {
+        if (earliestNs < 0 || entry.nextDueNs < earliestNs) {
+            earliestNs = entry.nextDueNs;
+        }
+    }
+    if (earliestNs < 0) {
+        m_timer->stop();
+        return;
+    }
+    // Rounded up, waking early would find nothing due and cost another wakeup.
+    const qint64 remainingNs = qMax<qint64>(0, earliestNs - m_clock.nsecsElapsed());
+    m_timer->start(int((remainingNs + kNsPerMs - 1) / kNsPerMs));
+}
+
+void PollScheduler::poll()
+{
+    const qint64 nowNs = m_clock.nsecsElapsed();
+    const bool connected = m_client->isConnected();
+
+    // Drops the references of destroyed consumers.
+    if (removeOwner(nullptr)) {
+        rebuild();
+    }
+
+    for (Entry &entry : m_entries) {
+        if (entry.nextDueNs > nowNs) {
+            continue;
+        }
+
+        // Serve the latest passed deadline only, the ones before it are missed.
+        const qint64 periodNs = entry.periodMs * kNsPerMs;
+        const qint64 lateNs = nowNs - entry.nextDueNs;
+        const qint64 missed = lateNs / periodNs;
+        entry.nextDueNs += (missed + 1) * periodNs;
+
+        // Ranges of one period form a pass; the visit of each goes into its frame,
+        // whatever the outcome.
+        quint64 cycle = 0;
+        if (!entry.visitedInPass) {
+            quint64 &pass = m_passCycles[entry.group.periodMs];
+            if (pass == 0) {
+                pass = m_assembler.beginCycle(entry.group.periodMs);
+            }
+            cycle = pass;
+            entry.visitedInPass = true;
+        }
+
+        const PollGroup &group = entry.group;
+        if (!connected) {
+            if (cycle != 0) {
+                m_assembler.addMissing(cycle, group.serverAddress, group.startAddress, group.numberOfEntries);
+            }
+            continue;
+        }
+
+        PollGroupStats &stats = entry.stats;
+        if (missed > 0) {
+            stats.missedDeadlines += quint64(missed);
+            qCDebug(lcPoll) << "Missed" << missed << "poll deadlines at" << group.startAddress;
+        }
+
+        const quint64 key = readKey(group);
+        if (m_pendingReads.contains(key)) {
+            // The previous read of this range has not come back, skip the cycle.
+            qCDebug(lcPoll) << "Skipping poll at" << group.startAddress << "still pending";
+            ++stats.skippedPending;
+            if (cycle != 0) {
+                m_assembler.addMissing(cycle, group.serverAddress, group.startAddress, group.numberOfEntries);
+            }
+            continue;
+        }
+
+        const qint64 jitterUs = (lateNs - missed * periodNs) / 1000;
+        ++stats.polls;
+        stats.lastJitterUs = jitterUs;
+        stats.maxJitterUs = qMax(stats.maxJitterUs, jitterUs);
+        stats.sumJitterUs += jitterUs;
+
+        if (cycle != 0) {
+            m_assembler.expectReply(cycle);
+        }
+        m_pendingReads.insert(key);
+        m_client->readHoldingRegisters(group.startAddress,
+                                       group.numberOfEntries,
+                                       this,
+                                       [this, key, cycle, serverAddress = group.serverAddress](const ModbusResult &result) {
+                                           m_pendingReads.remove(key);
+                                           if (cycle != 0) {
+                                               publish(m_assembler.addReply(cycle, serverAddress, result));
+                                           }
+                                       },
+                                       group.serverAddress,
+                                       // A scheduled poll must reach the device, or the group rate means nothing.
+                                       ModbusClient::ReadSource::Device);
+    }
+    closePassesIfDone();
+    rearm();
+}
+
+void PollScheduler::closePassesIfDone()
+{
+    for (auto it = m_passCycles.begin(); it != m_passCycles.end();) {
+        const int periodMs = it.key();
+        bool done = true;
+        for (const Entry &entry : std::as_const(m_entries)) {
+            if (entry.group.periodMs == periodMs && !entry.visitedInPass) {
+                done = false;
+                break;
+            }
+        }
+        if (!done) {
+            ++it;
+            continue;
+        }
+
+        for (Entry &entry : m_entries) {
+            if (entry.group.periodMs == periodMs) {
+                entry.visitedInPass = false;
+            }
+        }
+        const quint64 cycle = it.value();
+        it = m_passCycles.erase(it);
+        publish(m_assembler.sealCycle(cycle));
+    }
+}
+
+void PollScheduler::publish(const PollFramePtr &frame)
+{
+    if (frame) {
+        emit frameReady(frame);
+    }
+}
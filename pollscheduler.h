@@ -0,0 +1,147 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QPointer>
+#include <QSet>
+#include <QVector>
+#include <QtGlobal>
+
+#include "snapshotassembler.h"
+
+class ModbusClient;
+class QTimer;
+
+// A register range polled at its own rate. periodMs applies at the nominal base
+// period of one second and scales with PollScheduler::setBasePeriodMs().
+struct PollGroup
+{
+    int startAddress = 0;
+    quint16 numberOfEntries = 0;
+    int periodMs = 1000;
+    int serverAddress = 1;
+};
+
+// Timing of one polled range since it was scheduled. Jitter is how late a poll left
+// against its deadline; a deadline passed entirely while the thread was busy is
+// missed and not polled.
+struct PollGroupStats
+{
+    PollGroup group;
+    quint64 polls = 0;
+    quint64 missedDeadlines = 0;
+    quint64 skippedPending = 0;
+    qint64 lastJitterUs = 0;
+    qint64 maxJitterUs = 0;
+    qint64 sumJitterUs = 0;
+
+    qint64 meanJitterUs() const { return polls ? sumJitterUs / qint64(polls) : 0; }
+};
+
+/**
+ * @brief Polls register groups, each at its own period, from the Modbus thread.
+ *
+ * Consumers register the groups they display. Identical groups of several consumers,
+ * such as two docks of the same form, share one registration, polled while any of its
+ * owners is enabled. The enabled groups are then normalised into the ranges actually
+ * polled: each register goes to the fastest group asking for it, and registers of the
+ * same period are merged into one range, so no register is read twice per period.
+ * Ranges sharing a period are staggered across it.
+ *
+ * Deadlines are absolute on a monotonic clock, so late wakeups do not shift later
+ * polls. When the thread wakes after several deadlines passed, the group is polled
+ * once and the skipped deadlines are counted instead of sent in a burst.
+ *
+ * Ranges of the same period form passes: a pass starts when one of them comes due
+ * after the previous pass of the period closed, and closes once all of them have come
+ * due. Each pass yields one PollFrame spanning at most that period, so slow settings
+ * never hold back a frame of fast measurements. stop() drops the open passes.
+ */
+class PollScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit PollScheduler(ModbusClient *client, QObject *parent = nullptr);
+
+    // Replaces the groups of owner. They are dropped once owner is destroyed.
+    void setGroups(QObject *owner, const QVector<PollGroup> &groups, bool enabled);
+    void setOwnerEnabled(QObject *owner, bool enabled);
+
+    // Scales every group period by basePeriodMs / 1000.
+    void setBasePeriodMs(int basePeriodMs);
+    int basePeriodMs() const;
+
+    bool isRunning() const;
+
+    // Timing of each polled range, to be called in the scheduler's thread.
+    QVector<PollGroupStats> stats() const;
+
+    // Newest finished pass of the ranges of nominal period periodMs, safe to call from
+    // any thread.
+    PollFramePtr latestFrame(int periodMs) const;
+
+public slots:
+    void start();
+    void stop();
+
+signals:
+    // Every finished pass of every period, in the order the passes finish.
+    void frameReady(const PollFramePtr &frame);
+
+private:
+    struct Owner
+    {
+        QPointer<QObject> object;
+        bool enabled = true;
+        int periodMs = 1000;
+    };
+
+    // A group as registered by its consumers.
+    struct Registration
+    {
+        PollGroup group;
+        // Consumers registered for this range, it lives while one is left.
+        QVector<Owner> owners;
+
+        bool isEnabled() const;
+    };
+
+    // A range as polled, after normalisation.
+    struct Entry
+    {
+        PollGroup group;
+        int periodMs = 1000;
+        qint64 nextDueNs = 0;
+        // Came due in the open pass of its period.
+        bool visitedInPass = false;
+        PollGroupStats stats;
+    };
+
+    static quint64 readKey(const PollGroup &group);
+    // Drops owner, and destroyed owners, from every registration. Returns whether that
+    // changed what is polled.
+    bool removeOwner(QObject *owner);
+    void updateRegistration(Registration &registration);
+    // Normalises the enabled registrations into m_entries and restaggers them.
+    void rebuild();
+    void restagger();
+    void rearm();
+    void poll();
+    void closePassesIfDone();
+    void publish(const PollFramePtr &frame);
+
+    ModbusClient *m_client = nullptr;
+    QTimer *m_timer = nullptr;
+    QElapsedTimer m_clock;
+    QVector<Registration> m_registrations;
+    QVector<Entry> m_entries;
+    // Reads issued and not completed yet, a range is skipped while its read is pending.
+    QSet<quint64> m_pendingReads;
+    SnapshotAssembler m_assembler;
+    // Cycle of the open pass of each nominal period.
+    QHash<int, quint64> m_passCycles;
+    int m_basePeriodMs = 1000;
+    bool m_running = false;
+};
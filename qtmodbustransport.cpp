@@ -0,0 +1,224 @@
+#include "qtmodbustransport.h"
+
+#include <QtSerialBus/QModbusDataUnit>
+#include <QtSerialBus/QModbusDevice>
+#include <QtSerialBus/QModbusReply>
+#include <QtSerialBus/QModbusTcpClient>
+
+QtModbusTransport::QtModbusTransport(QObject *parent)
+    : ModbusTransport(parent)
+{
+    recreateClient();
+}
+
+QtModbusTransport::~QtModbusTransport() = default;
+
+void QtModbusTransport::recreateClient()
+{
+    if (m_client) {
+        disconnect(m_client, nullptr, this, nullptr);
+        m_client->deleteLater();
+    }
+    for (const auto &reply : std::as_const(m_replies)) {
+        if (reply) {
+            disconnect(reply, nullptr, this, nullptr);
+        }
+    }
+    m_replies.clear();
+
+    m_client = new QModbusTcpClient(this);
+
+    m_client->setConnectionParameter(QModbusDevice::NetworkAddressParameter, m_host);
+    m_client->setConnectionParameter(QModbusDevice::NetworkPortParameter, m_port);
+    m_client->setTimeout(m_timeoutMs);
+    m_client->setNumberOfRetries(0);
+
+    connect(m_client, &QModbusTcpClient::stateChanged, this, [this](QModbusDevice::State state) {
+        if (state == QModbusDevice::ConnectedState) {
+            emit stateChanged(Connected);
+        } else if (state == QModbusDevice::ConnectingState) {
+            emit stateChanged(Connecting);
+        } else if (state == QModbusDevice::UnconnectedState) {
+            emit stateChanged(Unconnected);
+        }
+    });
+
+    connect(m_client, &QModbusTcpClient::errorOccurred, this, [this](QModbusDevice::Error error) {
+        if (error == QModbusDevice::NoError) {
+            return;
+        }
+        emit errorOccurred(tr("Modbus client error: %1").arg(m_client->errorString()));
+    });
+}
+
+void QtModbusTransport::setConnectionParameters(const QString &host, quint16 port, int timeoutMs)
+{
+    m_host = host;
+    m_port = port;
+    m_timeoutMs = timeoutMs;
+
+    m_client->setConnectionParameter(QModbusDevice::NetworkAddressParameter, m_host);
+    m_client->setConnectionParameter(QModbusDevice::NetworkPortParameter, m_port);
+    m_client->setTimeout(m_timeoutMs);
+}
+
+bool QtModbusTransport::connectDevice()
+{
+    return m_client->connectDevice();
+}
+
+void QtModbusTransport::disconnectDevice()
+{
+    if (m_client->state() != QModbusDevice::UnconnectedState) {
+        m_client->disconnectDevice();
+    }
+}
+
+void QtModbusTransport::abort()
+{
+    // QModbusTcpClient cannot cancel a pending connect, start over with a fresh one.
+    const bool wasConnected = state() == Connected;
+    recreateClient();
+    if (wasConnected) {
+        emit stateChanged(Unconnected);
+    }
+}
+
+ModbusTransport::State QtModbusTransport::state() const
+{
+    switch (m_client->state()) {
+    case QModbusDevice::ConnectedState:
+        return Connected;
+    case QModbusDevice::ConnectingState:
+        return Connecting;
+    default:
+        return Unconnected;
+    }
+}
+
+QString QtModbusTransport::errorString() const
+{
+    return m_client->errorString();
+}
+
+bool QtModbusTransport::sendReadRequest(quint16 transactionId,
+                                        int startAddress,
+                                        quint16 numberOfEntries,
+                                        int serverAddress)
+{
+    if (m_client->state() != QModbusDevice::ConnectedState) {
+        return false;
+    }
+
+    return track(transactionId,
+                 m_client->sendReadRequest(
+                     QModbusDataUnit(QModbusDataUnit::HoldingRegisters, startAddress, numberOfEntries),
+                     serverAddress),
+                 true);
+}
+
+bool QtModbusTransport::sendWriteRequest(quint16 transactionId,
+                                         int startAddress,
+                                         const QVector<quint16> &values,
+                                         int serverAddress)
+{
+    if (m_client->state() != QModbusDevice::ConnectedState) {
+        return false;
+    }
+
+    QModbusDataUnit dataUnit(QModbusDataUnit::HoldingRegisters, startAddress, values);
+    return track(transactionId, m_client->sendWriteRequest(dataUnit, serverAddress), false);
+}
+
+bool QtModbusTransport::sendReadWriteRequest(quint16 transactionId,
+                                             int readStartAddress,
+                                             quint16 readNumberOfEntries,
+                                             int writeStartAddress,
+                                             const QVector<quint16> &values,
+                                             int serverAddress)
+{
+    if (m_client->state() != QModbusDevice::ConnectedState) {
+        return false;
+    }
+
+    // The reply result holds the read unit.
+    return track(transactionId,
+                 m_client->sendReadWriteRequest(
+                     QModbusDataUnit(QModbusDataUnit::HoldingRegisters, readStartAddress, readNumberOfEntries),
+                     QModbusDataUnit(QModbusDataUnit::HoldingRegisters, writeStartAddress, values),
+                     serverAddress),
+                 true);
+}
+
+void QtModbusTransport::cancel(quint16 transactionId)
+{
+    const QPointer<QModbusReply> reply = m_replies.take(transactionId);
+    if (reply) {
+        disconnect(reply, nullptr, this, nullptr);
+        reply->deleteLater();
+    }
+}
+
+bool QtModbusTransport::track(quint16 transactionId, QModbusReply *reply, bool isRead)
+{
+    if (!reply) {
+        return false;
+    }
+
+    m_replies.insert(transactionId, reply);
+    const auto onFinished = [this, reply, transactionId, isRead]() {
+        if (m_replies.value(transactionId) != reply) {
+            return;
+        }
+        m_replies.remove(transactionId);
+        const ModbusResult result = makeResult(reply, isRead);
+        reply->deleteLater();
+        emit finished(transactionId, result);
+    };
+
+    if (reply->isFinished()) {
+        // Never finish a request from inside the send call.
+        QMetaObject::invokeMethod(this, onFinished, Qt::QueuedConnection);
+    } else {
+        connect(reply, &QModbusReply::finished, this, onFinished);
+    }
+    return true;
+}
+
+ModbusResult QtModbusTransport::makeResult(QModbusReply *reply, bool isRead) const
+{
+    ModbusResult result;
+    const QModbusDataUnit unit = reply->result();
+    result.startAddress = unit.startAddress();
+    result.numberOfEntries = quint16(unit.valueCount());
+
+    if (reply->error() == QModbusDevice::NoError) {
+        if (isRead) {
+            // Shares the reply buffer; parts and subscribers get slices of it.
+            result.values = RegisterSlice(unit.values()).mid(0, int(unit.valueCount()));
+        }
+    } else if (reply->error() == QModbusDevice::ProtocolError) {
+        result.status = ModbusResult::ProtocolError;
+        result.exceptionCode = reply->rawResult().exceptionCode();
+        result.errorString = tr("Modbus reply protocol error: %1 (exception code: 0x%2)")
+                                 .arg(reply->errorString())
+                                 .arg(result.exceptionCode, 0, 16);
+    } else if (reply->error() == QModbusDevice::ReplyAbortedError) {
+        // Специальная обработка ошибки закрытия соединения
+        QString operation = isRead ? tr("read") : tr("write");
+        result.status = ModbusResult::Aborted;
+        result.errorString = tr("Modbus %1 operation aborted: connection was closed during request. "
+                                "The device may have disconnected or the connection timed out. "
+                                "Please check the connection and try again.")
+                                 .arg(operation);
+    } else {
+        result.status = reply->error() == QModbusDevice::TimeoutError ? ModbusResult::Timeout
+                                                                       : ModbusResult::Error;
+        result.errorString = tr("Modbus reply error: %1").arg(reply->errorString());
+    }
+
+    if (!result.isOk()) {
+        result.errorString += tr(" [code=%1]").arg(reply->error());
+    }
+    return result;
+}
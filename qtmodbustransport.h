@@ -0,0 +1,54 @@
+#pragma once
+
+#include <QHash>
+#include <QPointer>
+
+#include "modbustransport.h"
+
+class QModbusReply;
+class QModbusTcpClient;
+
+/**
+ * @brief ModbusTransport on top of QModbusTcpClient from Qt SerialBus.
+ */
+class QtModbusTransport : public ModbusTransport
+{
+    Q_OBJECT
+
+public:
+    explicit QtModbusTransport(QObject *parent = nullptr);
+    ~QtModbusTransport() override;
+
+    void setConnectionParameters(const QString &host, quint16 port, int timeoutMs) override;
+    bool connectDevice() override;
+    void disconnectDevice() override;
+    void abort() override;
+
+    State state() const override;
+    QString errorString() const override;
+
+    bool sendReadRequest(quint16 transactionId, int startAddress, quint16 numberOfEntries, int serverAddress) override;
+    bool sendWriteRequest(quint16 transactionId,
+                          int startAddress,
+                          const QVector<quint16> &values,
+                          int serverAddress) override;
+    bool sendReadWriteRequest(quint16 transactionId,
+                              int readStartAddress,
+                              quint16 readNumberOfEntries,
+                              int writeStartAddress,
+                              const QVector<quint16> &values,
+                              int serverAddress) override;
+    void cancel(quint16 transactionId) override;
+
+private:
+    void recreateClient();
+    bool track(quint16 transactionId, QModbusReply *reply, bool isRead);
+    ModbusResult makeResult(QModbusReply *reply, bool isRead) const;
+
+    QString m_host;
+    quint16 m_port = 502;
+    int m_timeoutMs = 1000;
+
+    QPointer<QModbusTcpClient> m_client;
+    QHash<quint16, QPointer<QModbusReply>> m_replies;
+};
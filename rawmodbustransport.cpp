@@ -0,0 +1,316 @@
+#include "rawmodbustransport.h"
+
+#include <QLoggingCategory>
+#include <QTcpSocket>
+#include <QtEndian>
+
+#include <cstring>
+
+namespace {
+QLoggingCategory lcRawModbus("modbus.raw");
+
+constexpr quint8 kReadHoldingRegisters = 0x03;
+constexpr quint8 kWriteMultipleRegisters = 0x10;
+constexpr quint8 kReadWriteMultipleRegisters = 0x17;
+constexpr quint8 kExceptionFlag = 0x80;
+
+// MBAP header: transaction id, protocol id, length, unit id.
+constexpr int kMbapHeaderSize = 7;
+// Largest Modbus TCP ADU: MBAP header plus a 253 byte PDU.
+constexpr int kMaxAduSize = kMbapHeaderSize + 253;
+constexpr quint16 kMaxWriteRegisters = 123;
+constexpr quint16 kMaxReadWriteWriteRegisters = 121;
+
+void putUint16(uchar *dst, quint16 value)
+{
+    qToBigEndian<quint16>(value, dst);
+}
+
+quint16 getUint16(const uchar *src)
+{
+    return qFromBigEndian<quint16>(src);
+}
+}
+
+RawModbusTransport::RawModbusTransport(QObject *parent)
+    : ModbusTransport(parent)
+    , m_socket(new QTcpSocket(this))
+    , m_pending(kPendingSlots)
+{
+    m_txBuffer.reserve(kMaxAduSize);
+    m_rxBuffer.reserve(16 * kMaxAduSize);
+
+    connect(m_socket, &QTcpSocket::stateChanged, this, [this](QAbstractSocket::SocketState socketState) {
+        if (socketState == QAbstractSocket::ConnectedState) {
+            m_socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+            emit stateChanged(Connected);
+        } else if (socketState == QAbstractSocket::UnconnectedState) {
+            // ModbusClient settles the requests in flight, writes among them are replayed.
+            clearPending();
+            m_rxBuffer.clear();
+            emit stateChanged(Unconnected);
+        } else if (socketState == QAbstractSocket::HostLookupState
+                   || socketState == QAbstractSocket::ConnectingState) {
+            emit stateChanged(Connecting);
+        }
+    });
+
+    connect(m_socket, &QTcpSocket::errorOccurred, this, [this](QAbstractSocket::SocketError) {
+        emit errorOccurred(tr("Modbus client error: %1").arg(m_socket->errorString()));
+    });
+
+    connect(m_socket, &QTcpSocket::readyRead, this, [this]() {
+        readFrames();
+    });
+}
+
+RawModbusTransport::~RawModbusTransport() = default;
+
+void RawModbusTransport::setConnectionParameters(const QString &host, quint16 port, int /*timeoutMs*/)
+{
+    // Reply timeouts are tracked by ModbusClient.
+    m_host = host;
+    m_port = port;
+}
+
+bool RawModbusTransport::connectDevice()
+{
+    if (m_socket->state() != QAbstractSocket::UnconnectedState) {
+        return m_socket->state() == QAbstractSocket::ConnectedState;
+    }
+    m_socket->connectToHost(m_host, m_port);
+    return true;
+}
+
+void RawModbusTransport::disconnectDevice()
+{
+    m_socket->disconnectFromHost();
+}
+
+void RawModbusTransport::abort()
+{
+    m_socket->abort();
+}
+
+ModbusTransport::State RawModbusTransport::state() const
+{
+    switch (m_socket->state()) {
+    case QAbstractSocket::ConnectedState:
+        return Connected;
+    case QAbstractSocket::UnconnectedState:
+        return Unconnected;
+    default:
+        return Connecting;
+    }
+}
+
+QString RawModbusTransport::errorString() const
+{
+    return m_socket->errorString();
+}
+
+RawModbusTransport::PendingRequest &RawModbusTransport::slotFor(quint16 transactionId)
+{
+    return m_pending[transactionId % kPendingSlots];
+}
+
+bool RawModbusTransport::sendReadRequest(quint16 transactionId,
+                                         int startAddress,
+                                         quint16 numberOfEntries,
+                                         int serverAddress)
+{
+    PendingRequest request;
+    request.transactionId = transactionId;
+    request.functionCode = kReadHoldingRegisters;
+    request.startAddress = startAddress;
+    request.numberOfEntries = numberOfEntries;
+
+    m_txBuffer.resize(kMbapHeaderSize + 5);
+    auto *pdu = reinterpret_cast<uchar *>(m_txBuffer.data()) + kMbapHeaderSize;
+    pdu[0] = kReadHoldingRegisters;
+    putUint16(pdu + 1, quint16(startAddress));
+    putUint16(pdu + 3, numberOfEntries);
+    return sendFrame(request, serverAddress);
+}
+
+bool RawModbusTransport::sendWriteRequest(quint16 transactionId,
+                                          int startAddress,
+                                          const QVector<quint16> &values,
+                                          int serverAddress)
+{
+    if (values.isEmpty() || values.size() > kMaxWriteRegisters) {
+        return false;
+    }
+
+    PendingRequest request;
+    request.transactionId = transactionId;
+    request.functionCode = kWriteMultipleRegisters;
+    request.startAddress = startAddress;
+    request.numberOfEntries = quint16(values.size());
+
+    m_txBuffer.resize(kMbapHeaderSize + 6 + 2 * values.size());
+    auto *pdu = reinterpret_cast<uchar *>(m_txBuffer.data()) + kMbapHeaderSize;
+    pdu[0] = kWriteMultipleRegisters;
+    putUint16(pdu + 1, quint16(startAddress));
+    putUint16(pdu + 3, request.numberOfEntries);
+    pdu[5] = uchar(2 * values.size());
+    for (int i = 0; i < values.size(); ++i) {
+        putUint16(pdu + 6 + 2 * i, values.at(i));
+    }
+    return sendFrame(request, serverAddress);
+}
+
+bool RawModbusTransport::sendReadWriteRequest(quint16 transactionId,
+                                              int readStartAddress,
+                                              quint16 readNumberOfEntries,
+                                              int writeStartAddress,
+                                              const QVector<quint16> &values,
+                                              int serverAddress)
+{
+    if (values.isEmpty() || values.size() > kMaxReadWriteWriteRegisters) {
+        return false;
+    }
+
+    // The pending request tracks the read range, which is what the response carries.
+    PendingRequest request;
+    request.transactionId = transactionId;
+    request.functionCode = kReadWriteMultipleRegisters;
+    request.startAddress = readStartAddress;
+    request.numberOfEntries = readNumberOfEntries;
+
+    m_txBuffer.resize(kMbapHeaderSize + 10 + 2 * values.size());
+    auto *pdu = reinterpret_cast<uchar *>(m_txBuffer.data()) + kMbapHeaderSize;
+    pdu[0] = kReadWriteMultipleRegisters;
+    putUint16(pdu + 1, quint16(readStartAddress));
+    putUint16(pdu + 3, readNumberOfEntries);
+    putUint16(pdu + 5, quint16(writeStartAddress));
+    putUint16(pdu + 7, quint16(values.size()));
+    pdu[9] = uchar(2 * values.size());
+    for (int i = 0; i < values.size(); ++i) {
+        putUint16(pdu + 10 + 2 * i, values.at(i));
+    }
+    return sendFrame(request, serverAddress);
+}
+
+bool RawModbusTransport::sendFrame(const PendingRequest &request, int serverAddress)
+{
+    if (m_socket->state() != QAbstractSocket::ConnectedState) {
+        return false;
+    }
+
+    PendingRequest &slot = slotFor(request.transactionId);
+    if (slot.active) {
+        qCWarning(lcRawModbus) << "No free slot for transaction" << request.transactionId;
+        return false;
+    }
+
+    auto *header = reinterpret_cast<uchar *>(m_txBuffer.data());
+    putUint16(header, request.transactionId);
+    putUint16(header + 2, 0);
+    putUint16(header + 4, quint16(m_txBuffer.size() - 6));
+    header[6] = uchar(serverAddress);
+
+    if (m_socket->write(m_txBuffer) != m_txBuffer.size()) {
+        return false;
+    }
+
+    slot = request;
+    slot.active = true;
+    return true;
+}
+
+void RawModbusTransport::cancel(quint16 transactionId)
+{
+    PendingRequest &slot = slotFor(transactionId);
+    if (slot.active && slot.transactionId == transactionId) {
+        slot.active = false;
+    }
+}
+
+void RawModbusTransport::readFrames()
+{
+    const qint64 available = m_socket->bytesAvailable();
+    if (available <= 0) {
+        return;
+    }
+
+    const int used = m_rxBuffer.size();
+    m_rxBuffer.resize(used + int(available));
+    const qint64 received = m_socket->read(m_rxBuffer.data() + used, available);
+    m_rxBuffer.resize(used + int(qMax<qint64>(0, received)));
+
+    const auto *data = reinterpret_cast<const uchar *>(m_rxBuffer.constData());
+    int offset = 0;
+    while (m_rxBuffer.size() - offset >= kMbapHeaderSize) {
+        const quint16 length = getUint16(data + offset + 4);
+        if (getUint16(data + offset + 2) != 0 || length < 2 || length + 6 > kMaxAduSize) {
+            emit errorOccurred(tr("Modbus framing error: invalid MBAP header, dropping the connection"));
+            m_rxBuffer.clear();
+            m_socket->abort();
+            return;
+        }
+
+        const int frameSize = 6 + length;
+        if (m_rxBuffer.size() - offset < frameSize) {
+            break;
+        }
+        handleFrame(data + offset, frameSize);
+        offset += frameSize;
+    }
+
+    // Keeps the reserved capacity, only the unparsed tail is moved to the front.
+    m_rxBuffer.remove(0, offset);
+}
+
+void RawModbusTransport::handleFrame(const uchar *frame, int length)
+{
+    const quint16 transactionId = getUint16(frame);
+    PendingRequest &slot = slotFor(transactionId);
+    if (!slot.active || slot.transactionId != transactionId) {
+        // Answer to a cancelled or timed out request.
+        return;
+    }
+    const PendingRequest request = slot;
+    slot.active = false;
+
+    const uchar *pdu = frame + kMbapHeaderSize;
+    const int pduLength = length - kMbapHeaderSize;
+
+    ModbusResult result;
+    result.startAddress = request.startAddress;
+    result.numberOfEntries = request.numberOfEntries;
+
+    if (pdu[0] == (request.functionCode | kExceptionFlag) && pduLength >= 2) {
+        result.status = ModbusResult::ProtocolError;
+        result.exceptionCode = pdu[1];
+        result.errorString = tr("Modbus reply protocol error: exception code: 0x%1").arg(result.exceptionCode, 0, 16);
+    } else if (pdu[0] != request.functionCode) {
+        result.status = ModbusResult::Error;
+        result.errorString = tr("Modbus reply error: unexpected function code 0x%1").arg(pdu[0], 0, 16);
+    } else if (request.functionCode == kReadHoldingRegisters || request.functionCode == kReadWriteMultipleRegisters) {
+        const int byteCount = pduLength >= 2 ? pdu[1] : -1;
+        if (byteCount != 2 * request.numberOfEntries || pduLength != 2 + byteCount) {
+            result.status = ModbusResult::Error;
+            result.errorString = tr("Modbus reply error: malformed read response");
+        } else {
+            QVector<quint16> values(request.numberOfEntries);
+            for (int i = 0; i < values.size(); ++i) {
+                values[i] = getUint16(pdu + 2 + 2 * i);
+            }
+            result.values = values;
+        }
+    } else if (pduLength != 5 || getUint16(pdu + 1) != quint16(request.startAddress)
+               || getUint16(pdu + 3) != request.numberOfEntries) {
+        result.status = ModbusResult::Error;
+        result.errorString = tr("Modbus reply error: malformed write response");
+    }
+
+    emit finished(transactionId, result);
+}
+
+void RawModbusTransport::clearPending()
+{
+    for (PendingRequest &slot : m_pending) {
+        slot.active = false;
+    }
+}
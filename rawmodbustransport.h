@@ -0,0 +1,72 @@
+#pragma once
+
+#include <QByteArray>
+#include <QVector>
+
+#include "modbustransport.h"
+
+class QTcpSocket;
+
+/**
+ * @brief ModbusTransport speaking Modbus TCP directly over a QTcpSocket.
+ *
+ * Builds and parses MBAP frames itself, using the transaction id as the MBAP transaction
+ * identifier. Frame buffers and the pending request table are allocated once, so a
+ * request costs no QObject and no heap allocation besides the register values of a read.
+ */
+class RawModbusTransport : public ModbusTransport
+{
+    Q_OBJECT
+
+public:
+    explicit RawModbusTransport(QObject *parent = nullptr);
+    ~RawModbusTransport() override;
+
+    void setConnectionParameters(const QString &host, quint16 port, int timeoutMs) override;
+    bool connectDevice() override;
+    void disconnectDevice() override;
+    void abort() override;
+
+    State state() const override;
+    QString errorString() const override;
+
+    bool sendReadRequest(quint16 transactionId, int startAddress, quint16 numberOfEntries, int serverAddress) override;
+    bool sendWriteRequest(quint16 transactionId,
+                          int startAddress,
+                          const QVector<quint16> &values,
+                          int serverAddress) override;
+    bool sendReadWriteRequest(quint16 transactionId,
+                              int readStartAddress,
+                              quint16 readNumberOfEntries,
+                              int writeStartAddress,
+                              const QVector<quint16> &values,
+                              int serverAddress) override;
+    void cancel(quint16 transactionId) override;
+
+private:
+    struct PendingRequest
+    {
+        bool active = false;
+        quint16 transactionId = 0;
+        quint8 functionCode = 0;
+        int startAddress = 0;
+        quint16 numberOfEntries = 0;
+    };
+
+    // Requests are looked up by the low byte of their transaction id.
+    static constexpr int kPendingSlots = 256;
+
+    PendingRequest &slotFor(quint16 transactionId);
+    bool sendFrame(const PendingRequest &request, int serverAddress);
+    void readFrames();
+    void handleFrame(const uchar *frame, int length);
+    void clearPending();
+
+    QString m_host;
+    quint16 m_port = 502;
+
+    QTcpSocket *m_socket = nullptr;
+    QByteArray m_txBuffer;
+    QByteArray m_rxBuffer;
+    QVector<PendingRequest> m_pending;
+};
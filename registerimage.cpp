@@ -0,0 +1,125 @@
+#include "registerimage.h"
+
+#include <QElapsedTimer>
+#include <QReadLocker>
+#include <QWriteLocker>
+
+RegisterImage::RegisterImage()
+    : m_registers(kEndAddress - kFirstAddress)
+{
+}
+
+qint64 RegisterImage::monotonicMs()
+{
+    QElapsedTimer timer;
+    timer.start();
+    return timer.msecsSinceReference();
+}
+
+bool RegisterImage::clip(int &startAddress, int &endAddress)
+{
+    startAddress = qMax(startAddress, kFirstAddress);
+    endAddress = qMin(endAddress, kEndAddress);
+    return startAddress < endAddress;
+}
+
+RegisterImage::Register RegisterImage::value(int address) const
+{
+    if (address < kFirstAddress || address >= kEndAddress) {
+        return {};
+    }
+
+    QReadLocker locker(&m_lock);
+    return m_registers.at(address - kFirstAddress);
+}
+
+QVector<RegisterImage::Register> RegisterImage::registers(int startAddress, int numberOfEntries) const
+{
+    int endAddress = startAddress + numberOfEntries;
+    if (!clip(startAddress, endAddress)) {
+        return {};
+    }
+
+    QReadLocker locker(&m_lock);
+    return m_registers.mid(startAddress - kFirstAddress, endAddress - startAddress);
+}
+
+bool RegisterImage::freshValues(int startAddress, int numberOfEntries, qint64 notBeforeMs, QVector<quint16> *values) const
+{
+    if (numberOfEntries <= 0 || startAddress < kFirstAddress || startAddress + numberOfEntries > kEndAddress) {
+        return false;
+    }
+
+    QVector<quint16> result(numberOfEntries);
+
+    QReadLocker locker(&m_lock);
+    for (int i = 0; i < numberOfEntries; ++i) {
+        const Register &reg = m_registers.at(startAddress - kFirstAddress + i);
+        if (reg.quality != Good || reg.timestampMs < notBeforeMs) {
+            return false;
+        }
+        result[i] = reg.value;
+    }
+
+    if (values) {
+        *values = result;
+    }
+    return true;
+}
+
+quint64 RegisterImage::sequence() const
+{
+    QReadLocker locker(&m_lock);
+    return m_sequence;
+}
+
+void RegisterImage::update(int startAddress, const RegisterSlice &values, QBitArray *changed)
+{
+    const int requestedStart = startAddress;
+    if (changed) {
+        // Registers outside the image are unknown and reported as changed.
+        *changed = QBitArray(values.size(), true);
+    }
+    int endAddress = startAddress + values.size();
+    if (!clip(startAddress, endAddress)) {
+        return;
+    }
+
+    const qint64 now = monotonicMs();
+
+    QWriteLocker locker(&m_lock);
+    ++m_sequence;
+    for (int address = startAddress; address < endAddress; ++address) {
+        Register &reg = m_registers[address - kFirstAddress];
+        const quint16 value = values.at(address - requestedStart);
+        if (changed && reg.quality == Good && reg.value == value) {
+            changed->clearBit(address - requestedStart);
+        }
+        reg.value = value;
+        reg.quality = Good;
+        reg.sequence = m_sequence;
+        reg.timestampMs = now;
+    }
+}
+
+void RegisterImage::markBad(int startAddress, int numberOfEntries)
+{
+    int endAddress = startAddress + numberOfEntries;
+    if (!clip(startAddress, endAddress)) {
+        return;
+    }
+
+    const qint64 now = monotonicMs();
+
+    QWriteLocker locker(&m_lock);
+    ++m_sequence;
+    for (int address = startAddress; address < endAddress; ++address) {
+        Register &reg = m_registers[address - kFirstAddress];
+        if (reg.quality == NoData) {
+            continue;
+        }
+        reg.quality = Bad;
+        reg.sequence = m_sequence;
+        reg.timestampMs = now;
+    }
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <QBitArray>
+#include <QReadWriteLock>
+#include <QVector>
+#include <QtGlobal>
+
+#include "registerslice.h"
+
+/**
+ * @brief Shadow copy of the laser holding register space (0x000-0x5FF).
+ *
+ * Every register keeps the last value seen on the wire together with its update time,
+ * the image sequence number of that update and a quality flag. The image is written by
+ * ModbusClient in the Modbus thread and may be read from any thread.
+ */
+class RegisterImage
+{
+public:
+    enum Quality : quint8
+    {
+        NoData, // Never read or written since start.
+        Good,   // Value confirmed by the last read or write.
+        Bad,    // Last request covering the register failed, value is the previous one.
+    };
+
+    struct Register
+    {
+        quint16 value = 0;
+        Quality quality = NoData;
+        quint64 sequence = 0;
+        qint64 timestampMs = 0;
+    };
+
+    static constexpr int kFirstAddress = 0x000;
+    static constexpr int kEndAddress = 0x600;
+
+    RegisterImage();
+
+    // Monotonic clock used for register timestamps.
+    static qint64 monotonicMs();
+
+    Register value(int address) const;
+    QVector<Register> registers(int startAddress, int numberOfEntries) const;
+
+    // Copies the range into values if every register in it is Good and was updated
+    // at or after notBeforeMs.
+    bool freshValues(int startAddress, int numberOfEntries, qint64 notBeforeMs, QVector<quint16> *values) const;
+
+    quint64 sequence() const;
+
+    // If changed is given, it receives one bit per value, set where the register was not
+    // Good or held a different value.
+    void update(int startAddress, const RegisterSlice &values, QBitArray *changed = nullptr);
+    void markBad(int startAddress, int numberOfEntries);
+
+private:
+    static bool clip(int &startAddress, int &endAddress);
+
+    mutable QReadWriteLock m_lock;
+    QVector<Register> m_registers;
+    quint64 m_sequence = 0;
+};
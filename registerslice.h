@@ -0,0 +1,59 @@
+#pragma once
+
+#include <QVector>
+#include <QtGlobal>
+
+/**
+ * @brief Read-only view of consecutive registers inside a shared reply buffer.
+ *
+ * Copies and sub-slices share the buffer of the reply they were cut from, so splitting a
+ * merged reply between its requesters and subscribers does not copy register values.
+ */
+class RegisterSlice
+{
+public:
+    RegisterSlice() = default;
+    RegisterSlice(const QVector<quint16> &buffer)
+        : m_buffer(buffer)
+        , m_count(int(buffer.size()))
+    {
+    }
+
+    int size() const { return m_count; }
+    bool isEmpty() const { return m_count == 0; }
+
+    const quint16 *data() const { return m_buffer.constData() + m_offset; }
+    const quint16 *begin() const { return data(); }
+    const quint16 *end() const { return data() + m_count; }
+
+    quint16 at(int index) const
+    {
+        Q_ASSERT(index >= 0 && index < m_count);
+        return data()[index];
+    }
+    quint16 operator[](int index) const { return at(index); }
+
+    RegisterSlice mid(int position, int length) const
+    {
+        RegisterSlice slice;
+        position = qBound(0, position, m_count);
+        slice.m_buffer = m_buffer;
+        slice.m_offset = m_offset + position;
+        slice.m_count = qBound(0, length, m_count - position);
+        return slice;
+    }
+
+    // Detached copy, for APIs that need a QVector.
+    QVector<quint16> toVector() const
+    {
+        if (m_offset == 0 && m_count == m_buffer.size()) {
+            return m_buffer;
+        }
+        return m_buffer.mid(m_offset, m_count);
+    }
+
+private:
+    QVector<quint16> m_buffer;
+    int m_offset = 0;
+    int m_count = 0;
+};
@@ -43,21 +43,49 @@ void SensorsTableForm::setModbusClient(ModbusClient *client)
     }
 
     if (m_modbusClient) {
-        disconnect(m_modbusClient, &ModbusClient::readCompleted,
-                   this, &SensorsTableForm::handleReadCompleted);
+        QMetaObject::invokeMethod(m_modbusClient,
+                                  [oldClient = m_modbusClient, form = static_cast<QObject *>(this)]() {
+                                      oldClient->unsubscribe(form);
+                                  },
+                                  Qt::QueuedConnection);
     }
-
     m_modbusClient = client;
-
-    if (m_modbusClient) {
-        connect(m_modbusClient, &ModbusClient::readCompleted,
-                this, &SensorsTableForm::handleReadCompleted);
-        // requestAllValues();
+    if (!m_modbusClient) {
+        return;
     }
+
+    // Every read covering the form's registers is routed here, whoever requested it.
+    QMetaObject::invokeMethod(m_modbusClient,
+                              [client = m_modbusClient, form = QPointer<SensorsTableForm>(this)]() {
+                                  if (!client || !form) {
+                                      return;
+                                  }
+                                  const auto onRead = [form](const ModbusResult &result) {
+                                      form->handleReadCompleted(result);
+                                  };
+                                  const auto delivery = SubscriptionRouter::ChangesOnly;
+                                  client->subscribe(SensorsTableAddress::CaseTemperature_1,
+                                                    SensorsTableAddress::AddressTillOfEndSensors - SensorsTableAddress::CaseTemperature_1,
+                                                    form,
+                                                    onRead,
+                                                    1,
+                                                    delivery);
+                                  client->subscribe(SensorsTableAddress::FrequencyIncomingSyncPulses_1, 1, form, onRead, 1, delivery);
+                                  client->subscribe(SensorsTableAddress::FrequencyIncomingSyncPulses_2, 1, form, onRead, 1, delivery);
+                                  client->subscribe(SensorsTableAddress::FrequencyIncomingSyncPulses_3, 1, form, onRead, 1, delivery);
+                              },
+                              Qt::QueuedConnection);
 }
 
-void SensorsTableForm::handleReadCompleted(int startAddress, const QVector<quint16> &values)
+void SensorsTableForm::handleReadCompleted(const ModbusResult &result)
 {
+    if (!result.isOk()) {
+        return;
+    }
+
+    const int startAddress = result.startAddress;
+    const RegisterSlice &values = result.values;
+
     if (m_addressToRow.constFind(startAddress) != m_addressToRow.constEnd())
     {
         qDebug() << "Received" << values.size() << "registers starting from" << startAddress;
@@ -79,6 +107,7 @@ void SensorsTableForm::handleReadCompleted(int startAddress, const QVector<quint
                 continue;
             }
 
+            const int firstIndex = valueIndex;
             if (currentAddress == SensorsTableAddress::FrequencyIncomingSyncPulses_1 ||
                 currentAddress == SensorsTableAddress::FrequencyIncomingSyncPulses_2 ||
                 currentAddress == SensorsTableAddress::FrequencyIncomingSyncPulses_3)
@@ -107,6 +136,10 @@ void SensorsTableForm::handleReadCompleted(int startAddress, const QVector<quint
 
             const auto rowIt = m_addressToRow.constFind(currentAddress);
             if (rowIt != m_addressToRow.constEnd()) {
+                if (!result.isChanged(firstIndex, valueIndex - firstIndex)) {
+                    currentAddress += valueIndex - firstIndex;
+                    continue;
+                }
                 const int row = rowIt.value();
                 QTableWidgetItem *valueItem = ui->sensorsTableWidget->item(row, 2);
                 if (!valueItem) {
@@ -197,7 +230,7 @@ void SensorsTableForm::insertRow(const BlockEntry &entry)
     m_addressToRow.insert(entry.address, row);
 }
 
-void SensorsTableForm::requestValueByValue() const
+void SensorsTableForm::requestValueByValue()
 {
     if (!m_modbusClient) {
         return;
@@ -206,19 +239,21 @@ void SensorsTableForm::requestValueByValue() const
     for (const auto &entry : m_entries) {
         const int address = entry.address;
         QMetaObject::invokeMethod(m_modbusClient,
-                                  [client = m_modbusClient, address]() {
-                                      if (!client) {
+                                  [client = m_modbusClient, form = QPointer<SensorsTableForm>(this), address]() {
+                                      if (!client || !form) {
                                           return;
                                       }
                                       client->readHoldingRegisters(address,
                                                                    address == SensorsTableAddress::BoardOperatingMode ||
-                                                                           address == SensorsTableAddress::LaserOperatingMode ? 1 : 2);
+                                                                           address == SensorsTableAddress::LaserOperatingMode ? 1 : 2,
+                                                                   form,
+                                                                   {});
                                   },
                                   Qt::QueuedConnection);
     }
 }
 
-void SensorsTableForm::requestAllValues() const
+void SensorsTableForm::requestAllValues()
 {
     if (!m_modbusClient) {
         return;
@@ -229,18 +264,31 @@ void SensorsTableForm::requestAllValues() const
     const int registerCount = SensorsTableAddress::AddressTillOfEndSensors - startAddress; // 0x100-0x12e
 
     QMetaObject::invokeMethod(m_modbusClient,
-                              [client = m_modbusClient, startAddress, registerCount]() {
-                                  if (!client) {
+                              [client = m_modbusClient, form = QPointer<SensorsTableForm>(this), startAddress, registerCount]() {
+                                  if (!client || !form) {
                                       return;
                                   }
-                                  client->readHoldingRegisters(startAddress, registerCount);
-                                  client->readHoldingRegisters(SensorsTableAddress::FrequencyIncomingSyncPulses_1, 1);
-                                  client->readHoldingRegisters(SensorsTableAddress::FrequencyIncomingSyncPulses_2, 1);
-                                  client->readHoldingRegisters(SensorsTableAddress::FrequencyIncomingSyncPulses_3, 1);
+                                  client->readHoldingRegisters(startAddress, registerCount, form, {});
+                                  client->readHoldingRegisters(SensorsTableAddress::FrequencyIncomingSyncPulses_1, 1, form, {});
+                                  client->readHoldingRegisters(SensorsTableAddress::FrequencyIncomingSyncPulses_2, 1, form, {});
+                                  client->readHoldingRegisters(SensorsTableAddress::FrequencyIncomingSyncPulses_3, 1, form, {});
                               },
                               Qt::QueuedConnection);
 }
 
+QVector<PollGroup> SensorsTableForm::pollGroups() const
+{
+    // Power and crystal temperatures follow the laser closely, the rest changes slowly.
+    return {
+        {SensorsTableAddress::FrequencyIncomingSyncPulses_1, 1, 1000},
+        {SensorsTableAddress::FrequencyIncomingSyncPulses_2, 1, 1000},
+        {SensorsTableAddress::FrequencyIncomingSyncPulses_3, 1, 1000},
+        {SensorsTableAddress::CaseTemperature_1, SensorsTableAddress::LaserPower - SensorsTableAddress::CaseTemperature_1, 1000},
+        {SensorsTableAddress::LaserPower, SensorsTableAddress::CrystalTemperature_2 + 2 - SensorsTableAddress::LaserPower, 250},
+        {SensorsTableAddress::LaserWorkTime, SensorsTableAddress::AddressTillOfEndSensors - SensorsTableAddress::LaserWorkTime, 1000},
+    };
+}
+
 void SensorsTableForm::on_pushButton_clicked()
 {
     requestAllValues();
@@ -0,0 +1,123 @@
+#include "snapshotassembler.h"
+
+#include <QMutexLocker>
+
+bool PollFrame::isComplete() const
+{
+    for (const Range &range : ranges) {
+        if (range.status != ModbusResult::Ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool PollFrame::value(int address, quint16 *value, int serverAddress) const
+{
+    for (const Range &range : ranges) {
+        const int offset = address - range.startAddress;
+        if (range.serverAddress == serverAddress && range.status == ModbusResult::Ok && offset >= 0
+            && offset < range.values.size()) {
+            if (value) {
+                *value = range.values.at(offset);
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+quint64 SnapshotAssembler::beginCycle(int periodMs)
+{
+    const quint64 cycle = m_nextCycle++;
+    OpenCycle &open = m_openCycles[cycle];
+    open.frame.periodMs = periodMs;
+    open.frame.sequence = ++m_lastSequences[periodMs];
+    open.frame.startedUs = ModbusResult::monotonicUs();
+    return cycle;
+}
+
+void SnapshotAssembler::expectReply(quint64 cycle)
+{
+    const auto it = m_openCycles.find(cycle);
+    if (it != m_openCycles.end()) {
+        ++it->outstanding;
+    }
+}
+
+void SnapshotAssembler::addMissing(quint64 cycle, int serverAddress, int startAddress, quint16 numberOfEntries)
+{
+    const auto it = m_openCycles.find(cycle);
+    if (it == m_openCycles.end()) {
+        return;
+    }
+
+    PollFrame::Range range;
+    range.startAddress = startAddress;
+    range.numberOfEntries = numberOfEntries;
+    range.serverAddress = serverAddress;
+    range.status = ModbusResult::Aborted;
+    it->frame.ranges.append(range);
+}
+
+PollFramePtr SnapshotAssembler::addReply(quint64 cycle, int serverAddress, const ModbusResult &result)
+{
+    const auto it = m_openCycles.find(cycle);
+    if (it == m_openCycles.end()) {
+        return {};
+    }
+
+    PollFrame::Range range;
+    range.startAddress = result.startAddress;
+    range.numberOfEntries = result.numberOfEntries;
+    range.serverAddress = serverAddress;
+    range.status = result.status;
+    range.receivedUs = result.receivedUs;
+    if (result.isOk()) {
+        range.values = result.values.toVector();
+    }
+    it->frame.ranges.append(range);
+    --it->outstanding;
+    return finishIfDone(cycle);
+}
+
+PollFramePtr SnapshotAssembler::sealCycle(quint64 cycle)
+{
+    const auto it = m_openCycles.find(cycle);
+    if (it == m_openCycles.end()) {
+        return {};
+    }
+    it->sealed = true;
+    return finishIfDone(cycle);
+}
+
+void SnapshotAssembler::dropCycle(quint64 cycle)
+{
+    m_openCycles.remove(cycle);
+}
+
+PollFramePtr SnapshotAssembler::latestFrame(int periodMs) const
+{
+    QMutexLocker locker(&m_latestLock);
+    return m_latest.value(periodMs);
+}
+
+PollFramePtr SnapshotAssembler::finishIfDone(quint64 cycle)
+{
+    const auto it = m_openCycles.find(cycle);
+    if (!it->sealed || it->outstanding > 0) {
+        return {};
+    }
+
+    auto *frame = new PollFrame(std::move(it->frame));
+    m_openCycles.erase(it);
+    frame->completedUs = ModbusResult::monotonicUs();
+    const PollFramePtr published(frame);
+
+    QMutexLocker locker(&m_latestLock);
+    PollFramePtr &latest = m_latest[published->periodMs];
+    if (!latest || latest->sequence < published->sequence) {
+        latest = published;
+    }
+    return published;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <QHash>
+#include <QMetaType>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QVector>
+#include <QtGlobal>
+
+#include "modbusresult.h"
+
+/**
+ * @brief Replies of one poll pass, never modified once published.
+ *
+ * A pass visits every range polled at one period once, so it spans at most that
+ * period. A range that was not read, because the link was down or its previous read
+ * was still pending, has status Aborted and no values. Sequence numbers count the
+ * passes of each period, read or not, so a gap between two frames of a period seen by
+ * a consumer is a pass it missed.
+ */
+struct PollFrame
+{
+    struct Range
+    {
+        int startAddress = 0;
+        quint16 numberOfEntries = 0;
+        int serverAddress = 1;
+        ModbusResult::Status status = ModbusResult::Ok;
+        qint64 receivedUs = 0;
+        QVector<quint16> values;
+    };
+
+    // Nominal period of the ranges in this frame, see PollGroup::periodMs.
+    int periodMs = 0;
+    quint64 sequence = 0;
+    // Monotonic times (see ModbusResult::monotonicUs()) of the start of the pass and
+    // of its last reply.
+    qint64 startedUs = 0;
+    qint64 completedUs = 0;
+    QVector<Range> ranges;
+
+    // Every group of the pass was read successfully.
+    bool isComplete() const;
+    // Value of a register read successfully in this pass.
+    bool value(int address, quint16 *value, int serverAddress = 1) const;
+};
+
+using PollFramePtr = QSharedPointer<const PollFrame>;
+Q_DECLARE_METATYPE(PollFramePtr)
+
+/**
+ * @brief Collects the replies of each poll pass into a PollFrame.
+ *
+ * Used by PollScheduler in the Modbus thread. A frame is finished once its cycle is
+ * sealed and every read has completed, whatever the outcome. latestFrame() may be
+ * called from any thread.
+ */
+class SnapshotAssembler
+{
+public:
+    quint64 beginCycle(int periodMs);
+    void expectReply(quint64 cycle);
+    // Records a range the cycle was meant to read but did not.
+    void addMissing(quint64 cycle, int serverAddress, int startAddress, quint16 numberOfEntries);
+    // Both return the frame when this finishes the cycle, null otherwise.
+    PollFramePtr addReply(quint64 cycle, int serverAddress, const ModbusResult &result);
+    PollFramePtr sealCycle(quint64 cycle);
+    // Forgets an open cycle, its late replies are ignored.
+    void dropCycle(quint64 cycle);
+
+    // Cycles can finish out of order; this is the newest finished one of the period.
+    PollFramePtr latestFrame(int periodMs) const;
+
+private:
+    struct OpenCycle
+    {
+        PollFrame frame;
+        int outstanding = 0;
+        bool sealed = false;
+    };
+
+    PollFramePtr finishIfDone(quint64 cycle);
+
+    QHash<quint64, OpenCycle> m_openCycles;
+    quint64 m_nextCycle = 1;
+    QHash<int, quint64> m_lastSequences;
+    mutable QMutex m_latestLock;
+    QHash<int, PollFramePtr> m_latest;
+};
@@ -0,0 +1,162 @@
+#include "subscriptionrouter.h"
+
+int SubscriptionRouter::subscribe(QObject *context,
+                                  int serverAddress,
+                                  int startAddress,
+                                  quint16 numberOfEntries,
+                                  ModbusCallback callback,
+                                  Delivery delivery)
+{
+    if (!context || !callback || numberOfEntries == 0) {
+        return 0;
+    }
+
+    const int id = m_nextId++;
+    Subscription subscription{context, serverAddress, startAddress, numberOfEntries, std::move(callback), delivery,
+                              QBitArray(numberOfEntries, true)};
+    addToIndex(id, subscription);
+    m_subscriptions.insert(id, std::move(subscription));
+    return id;
+}
+
+void SubscriptionRouter::unsubscribe(int id)
+{
+    const auto it = m_subscriptions.find(id);
+    if (it == m_subscriptions.end()) {
+        return;
+    }
+
+    removeFromIndex(id, it.value());
+    m_subscriptions.erase(it);
+}
+
+void SubscriptionRouter::unsubscribe(QObject *context)
+{
+    for (auto it = m_subscriptions.begin(); it != m_subscriptions.end();) {
+        if (it->context == context || !it->context) {
+            removeFromIndex(it.key(), it.value());
+            it = m_subscriptions.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void SubscriptionRouter::deliver(int id, int startAddress, const RegisterSlice &values)
+{
+    const auto it = m_subscriptions.find(id);
+    if (it == m_subscriptions.end() || !it->context || startAddress != it->startAddress
+        || values.size() != it->numberOfEntries) {
+        return;
+    }
+
+    it->undelivered.fill(false);
+    ModbusResult result;
+    result.startAddress = startAddress;
+    result.numberOfEntries = it->numberOfEntries;
+    result.values = values;
+    QMetaObject::invokeMethod(
+        it->context,
+        [callback = it->callback, result]() {
+            callback(result);
+        },
+        Qt::QueuedConnection);
+}
+
+int SubscriptionRouter::count() const
+{
+    return m_subscriptions.size();
+}
+
+quint32 SubscriptionRouter::pageKey(int serverAddress, int address)
+{
+    return (quint32(serverAddress & 0xFF) << 16) | quint32((address & 0xFFFF) / kPageSize);
+}
+
+void SubscriptionRouter::addToIndex(int id, const Subscription &subscription)
+{
+    const int lastAddress = subscription.startAddress + subscription.numberOfEntries - 1;
+    for (int page = subscription.startAddress / kPageSize; page <= lastAddress / kPageSize; ++page) {
+        m_pages[pageKey(subscription.serverAddress, page * kPageSize)].append(id);
+    }
+}
+
+void SubscriptionRouter::removeFromIndex(int id, const Subscription &subscription)
+{
+    const int lastAddress = subscription.startAddress + subscription.numberOfEntries - 1;
+    for (int page = subscription.startAddress / kPageSize; page <= lastAddress / kPageSize; ++page) {
+        const auto it = m_pages.find(pageKey(subscription.serverAddress, page * kPageSize));
+        if (it == m_pages.end()) {
+            continue;
+        }
+        it->removeOne(id);
+        if (it->isEmpty()) {
+            m_pages.erase(it);
+        }
+    }
+}
+
+void SubscriptionRouter::route(int serverAddress, int startAddress, const RegisterSlice &values, const QBitArray &changed)
+{
+    if (values.isEmpty()) {
+        return;
+    }
+
+    const int endAddress = startAddress + values.size();
+    const int firstPage = startAddress / kPageSize;
+    const int lastPage = (endAddress - 1) / kPageSize;
+    QVector<int> expired;
+
+    for (int page = firstPage; page <= lastPage; ++page) {
+        const auto bucket = m_pages.constFind(pageKey(serverAddress, page * kPageSize));
+        if (bucket == m_pages.constEnd()) {
+            continue;
+        }
+
+        for (const int id : *bucket) {
+            Subscription &subscription = m_subscriptions[id];
+            if (!subscription.context) {
+                expired.append(id);
+                continue;
+            }
+
+            const int overlapStart = qMax(startAddress, subscription.startAddress);
+            const int overlapEnd = qMin(endAddress, subscription.startAddress + int(subscription.numberOfEntries));
+            // A subscription spanning several pages is delivered once, from the first shared page.
+            if (overlapStart >= overlapEnd || overlapStart / kPageSize != page) {
+                continue;
+            }
+
+            QBitArray overlapChanged;
+            if (!changed.isEmpty()) {
+                overlapChanged.resize(overlapEnd - overlapStart);
+                for (int i = 0; i < overlapChanged.size(); ++i) {
+                    overlapChanged.setBit(i, changed.testBit(overlapStart - startAddress + i)
+                                                 || subscription.undelivered.testBit(overlapStart - subscription.startAddress + i));
+                }
+                if (subscription.delivery == ChangesOnly && overlapChanged.count(true) == 0) {
+                    continue;
+                }
+            }
+            for (int address = overlapStart; address < overlapEnd; ++address) {
+                subscription.undelivered.clearBit(address - subscription.startAddress);
+            }
+
+            ModbusResult result;
+            result.startAddress = overlapStart;
+            result.numberOfEntries = quint16(overlapEnd - overlapStart);
+            result.values = values.mid(overlapStart - startAddress, overlapEnd - overlapStart);
+            result.changed = overlapChanged;
+            QMetaObject::invokeMethod(
+                subscription.context,
+                [callback = subscription.callback, result]() {
+                    callback(result);
+                },
+                Qt::QueuedConnection);
+        }
+    }
+
+    for (const int id : expired) {
+        unsubscribe(id);
+    }
+}
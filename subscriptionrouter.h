@@ -0,0 +1,70 @@
+#pragma once
+
+#include <QHash>
+#include <QObject>
+#include <QPointer>
+#include <QVector>
+#include <QtGlobal>
+
+#include "modbusresult.h"
+
+/**
+ * @brief Routes register updates to the consumers whose address range they overlap.
+ *
+ * Subscriptions are indexed by fixed-size address pages, so routing a reply only looks
+ * at the subscriptions sharing a page with it, however many docks are subscribed.
+ * Owned and used by ModbusClient in the Modbus thread.
+ */
+class SubscriptionRouter
+{
+public:
+    static constexpr int kPageSize = 64;
+
+    enum Delivery
+    {
+        EveryUpdate, // Every update overlapping the range.
+        ChangesOnly, // Only updates that change at least one register in the range.
+    };
+
+    // Returns the subscription id. The callback runs in the thread of context and the
+    // subscription is dropped once context is destroyed.
+    int subscribe(QObject *context,
+                  int serverAddress,
+                  int startAddress,
+                  quint16 numberOfEntries,
+                  ModbusCallback callback,
+                  Delivery delivery = EveryUpdate);
+    void unsubscribe(int id);
+    void unsubscribe(QObject *context);
+
+    // Delivers the part of the update overlapping each subscription's range, with the
+    // matching part of the change mask. An empty mask marks every value as changed.
+    // Registers not yet delivered to a subscription are always marked changed, so each
+    // of them reaches it once even if its value never changes.
+    void route(int serverAddress, int startAddress, const RegisterSlice &values, const QBitArray &changed = {});
+    // Delivers values covering the whole range to subscription id alone.
+    void deliver(int id, int startAddress, const RegisterSlice &values);
+
+    int count() const;
+
+private:
+    struct Subscription
+    {
+        QPointer<QObject> context;
+        int serverAddress = 1;
+        int startAddress = 0;
+        quint16 numberOfEntries = 0;
+        ModbusCallback callback;
+        Delivery delivery = EveryUpdate;
+        // Registers of the range never delivered to this subscription.
+        QBitArray undelivered;
+    };
+
+    static quint32 pageKey(int serverAddress, int address);
+    void addToIndex(int id, const Subscription &subscription);
+    void removeFromIndex(int id, const Subscription &subscription);
+
+    QHash<int, Subscription> m_subscriptions;
+    QHash<quint32, QVector<int>> m_pages;
+    int m_nextId = 1;
+};